@@ -32,7 +32,7 @@
 #include <list>
 #include "omp_adapter.h"
 
-const std::string VERSION = "0.40";
+const std::string VERSION = "0.47";
 
 typedef uint64_t hash_t;
 
@@ -41,10 +41,55 @@ typedef uint64_t hash_t;
 #include "aligns_to_db_job.h"
 #include "aligns_to_dbs_job.h"
 #include "aligns_to_dbss_job.h"
+#include "aligns_to_server.h"
 
 using namespace std;
 using namespace std::chrono;
 
+struct InputResult
+{
+    Job::Stats stats;
+    double seconds;
+    std::string error;
+    InputResult() : seconds(0) {}
+};
+
+// to_file - matches go to <input>.matches, otherwise to stdout
+InputResult process_input(Job &job, const std::string &filename, bool to_file)
+{
+    LOG(filename);
+    InputResult result;
+    auto before = high_resolution_clock::now();
+    if (to_file)
+    {
+        ofstream out_f(filename + ".matches");
+        out_f.flush(); // ?
+        result.stats = job.run(filename, out_f);
+        if (!out_f)
+            throw std::runtime_error("cannot write " + filename + ".matches");
+    }
+    else
+        result.stats = job.run(filename, cout);
+
+    result.seconds = duration_cast<duration<double>>(high_resolution_clock::now() - before).count();
+    LOG("processing time (sec) " << size_t(result.seconds) << " " << filename);
+    return result;
+}
+
+void save_summary(const std::string &filename, const std::vector<std::string> &inputs, const std::vector<InputResult> &results)
+{
+    ofstream f(filename);
+    f << "input\tspots\treads\tmatched_reads\tseconds\tstatus" << endl;
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        auto &r = results[i];
+        f << inputs[i] << '\t' << r.stats.spot_count << '\t' << r.stats.read_count << '\t' << r.stats.matched_count << '\t' << r.seconds << '\t' << (r.error.empty() ? "ok" : "error") << endl;
+    }
+
+    if (!f)
+        throw std::runtime_error("cannot write summary " + filename);
+}
+
 int main(int argc, char const *argv[])
 {
     #ifdef __GNUC__
@@ -54,6 +99,8 @@ int main(int argc, char const *argv[])
     LOG("aligns_to version " << VERSION);
     LOG("hardware threads: "  << std::thread::hardware_concurrency() << ", omp threads: " << omp_get_max_threads());
     Config config(argc, argv);
+    if (!config.client_socket.empty())
+        return AlignsToServer::request(config.client_socket, config.contig_file);
 
     auto before = high_resolution_clock::now();
 
@@ -72,31 +119,58 @@ int main(int argc, char const *argv[])
     if (job->db_kmers() > 0)
         LOG("kmers " << job->db_kmers() << " (" << (job->db_kmers() / 1000 / 1000) << "m)");
 
-    if (!config.contig_files.empty())
-	{
-        for (auto &filename : config.contig_files)
-            {
-                LOG(filename);
-                before = high_resolution_clock::now();
-                {
-                    ofstream out_f(filename + ".matches");
-                    out_f.flush(); // ?
-                    job->run(filename, out_f);
-                }
-
-                auto processing_time = std::chrono::duration_cast<std::chrono::seconds>( high_resolution_clock::now() - before ).count();
-                LOG("processing time (sec) " << processing_time);
-            }
+    if (!config.server_socket.empty())
+    {
+        AlignsToServer::serve(*job, config.server_socket);
+        return 0;
     }
-    else
-	{
+
+    std::vector<std::string> inputs(config.contig_files.begin(), config.contig_files.end());
+    if (inputs.empty())
+    {
         if (config.contig_file.empty())
             throw std::runtime_error("contig file(s) is empty");
 
-        LOG(config.contig_file);
-        job->run(config.contig_file, cout);
+        inputs.push_back(config.contig_file);
     }
 
+    std::vector<InputResult> results(inputs.size());
+    if (!config.contig_files.empty() && config.batch > 1)
+    {
+        // several inputs at once, the threads are shared between them
+        int threads = omp_get_max_threads();
+        int batch = std::min(config.batch, int(inputs.size()));
+        LOG("batch of " << batch << " inputs at once, " << std::max(1, threads / batch) << " threads each");
+        omp_set_max_active_levels(2);
+
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(batch)
+        for (size_t i = 0; i < inputs.size(); i++)
+        {
+            omp_set_num_threads(std::max(1, threads / batch));
+            try
+            {
+                results[i] = process_input(*job, inputs[i], true);
+            }
+            catch (std::exception &e)
+            {
+                LOG(inputs[i] << " failed: " << e.what());
+                results[i].error = e.what();
+            }
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < inputs.size(); i++)
+            results[i] = process_input(*job, inputs[i], !config.contig_files.empty());
+    }
+
+    if (!config.summary_file.empty())
+        save_summary(config.summary_file, inputs, results);
+
+    for (auto &result : results)
+        if (!result.error.empty())
+            return 1;
+
     LOG("total time (sec) " << std::chrono::duration_cast<std::chrono::seconds>( high_resolution_clock::now() - before ).count());
 
 //    std::exit(0); // dont want to wait for destructors
@@ -30,12 +30,13 @@
 #include "aligns_to_job.h"
 #include "hash.h"
 #include "seq_transform.h"
+#include "kmer_search.h"
 #include <map>
 #include "omp_adapter.h"
 
 struct DBJob : public Job
 {
-	typedef std::vector<hash_t> HashSortedArray;
+	typedef DBSArray<hash_t> HashSortedArray;
 
 	HashSortedArray hash_array;
 	size_t kmer_len;
@@ -44,20 +45,24 @@ struct DBJob : public Job
 	DBJob(const Config &config) : config(config)
 	{
 		kmer_len = DBSIO::load_dbs(config.db, hash_array);
+		search.reset(new Search(hash_array.begin(), hash_array.size(), kmer_len, config.search_layout));
 	}
 
+	typedef KmerSearch<hash_t, hash_t> Search;
+	std::unique_ptr<Search> search;
+
 	struct Matcher
 	{
-		const HashSortedArray &hash_array;
+		const Search &search;
 		size_t kmer_len;
-		Matcher(const HashSortedArray &hash_array, size_t kmer_len) : hash_array(hash_array), kmer_len(kmer_len){}
+		Matcher(const Search &search, size_t kmer_len) : search(search), kmer_len(kmer_len){}
 
-		int operator() (const std::string &seq) const 
+		int operator() (const p_string &seq) const 
 		{
 			int found = 0;
-			Hash<hash_t>::for_all_hashes_do(seq, kmer_len, [&](hash_t hash)
+			search.find_all_kmers(seq.s, seq.len, [&](const hash_t *in_db, hash_t)
 				{
-					if (in_db(hash) > 0)
+					if (in_db)
 						found++;
 
 					return !found;
@@ -65,19 +70,13 @@ struct DBJob : public Job
 
 			return found;
 		}
-
-		bool in_db(hash_t hash) const
-		{
-			hash = seq_transform<hash_t>::min_hash_variant(hash, kmer_len);
-			return std::binary_search(hash_array.begin(), hash_array.end(), hash);
-		}
 	};
 
-	virtual void run(const std::string &filename, std::ostream &out_f)
+	virtual Stats run(const std::string &filename, std::ostream &out_f)
 	{
-		Matcher m(hash_array, kmer_len);
+		Matcher m(*search, kmer_len);
 		BasicPrinter print(out_f);
-		Job::run<Matcher, BasicPrinter>(filename, print, m, kmer_len, config.spot_filter_file, config.unaligned_only);
+		return Job::run<Matcher, BasicPrinter>(filename, print, m, kmer_len, config.spot_filter_file, config.unaligned_only, config.ordered_output);
 	}
 };
 
@@ -28,6 +28,9 @@
 #define ALIGNS_TO_DBS_JOB_H_INCLUDED
 
 #include "aligns_to_job.h"
+#include "kmer_search.h"
+#include "mismatch_index.h"
+#include "seq_transform.h"
 
 struct DBSJob : public Job
 {
@@ -42,7 +45,7 @@ struct DBSJob : public Job
 	};
 
 	const Config &config;
-	typedef std::vector<KmerTax> HashSortedArray;
+	typedef DBSArray<KmerTax> HashSortedArray;
 
 	HashSortedArray hash_array;
     static const int DEFAULT_KMER_LEN = 32;
@@ -56,133 +59,134 @@ protected:
 
 public:
 
-	struct Hits : public std::map<tax_t, int>
+	// kmer counts by tax id, sorted by tax id
+	// first INLINE_HITS are kept in place, so short reads never touch the heap
+	class Hits
 	{
-		operator bool() const { return size() != 0; }
+	public:
+		typedef std::pair<tax_t, int> Hit;
+
+		Hits() : hits_count(0) {}
+
+		operator bool() const { return hits_count != 0; }
+		size_t size() const { return hits_count; }
+		const Hit *begin() const { return hits_count <= INLINE_HITS ? inline_hits : spilled_hits.data(); }
+		const Hit *end() const { return begin() + hits_count; }
+
+		void add(tax_t tax_id, int count) // tax ids must come in increasing order
+		{
+			if (hits_count < INLINE_HITS)
+				inline_hits[hits_count] = Hit(tax_id, count);
+			else
+			{
+				if (hits_count == INLINE_HITS)
+					spilled_hits.assign(inline_hits, inline_hits + INLINE_HITS);
+
+				spilled_hits.push_back(Hit(tax_id, count));
+			}
+
+			hits_count++;
+		}
 
         void operator += (const Hits &x)
         {
-            for (auto &other : x)
-                (*this)[other.first] += other.second;
+			Hits sum;
+			auto a = begin(), b = x.begin();
+			while (a != end() || b != x.end())
+			{
+				if (b == x.end() || (a != end() && a->first < b->first))
+					sum.add(a->first, a->second), a++;
+				else if (a == end() || b->first < a->first)
+					sum.add(b->first, b->second), b++;
+				else
+					sum.add(a->first, a->second + b->second), a++, b++;
+			}
+
+			*this = std::move(sum);
         }
+
+	private:
+		static const size_t INLINE_HITS = 8;
+		size_t hits_count;
+		Hit inline_hits[INLINE_HITS];
+		std::vector<Hit> spilled_hits;
 	};
 
 	virtual size_t db_kmers() const { return hash_array.size();}
 
-	struct Matcher
-	{
-        typedef std::vector< std::pair<size_t, size_t> > HashLookupTable;
-		const HashSortedArray &hash_array;
-        HashLookupTable hash_lookup_table;
-        int hash_lookup_shift;
-		int kmer_len;
-		Matcher(const HashSortedArray &hash_array, int kmer_len) : hash_array(hash_array), kmer_len(kmer_len)
-        {
-            // determining size of lookup key
-            int lookup_key_bits = 1;
-            while ((hash_array.size() >> lookup_key_bits) > 5)
-            {
-                lookup_key_bits += 1;
-            }
-            hash_lookup_shift = kmer_len * 2 - lookup_key_bits;
-
-            const size_t bucket_count = size_t(1) << lookup_key_bits;
-            LOG("creating lookup table with " << bucket_count << " buckets, on average " << (float(hash_array.size()) / bucket_count) << " hashes per bucket");
-            hash_lookup_table.resize(bucket_count);
-
-            // figuring out bucket ranges
-            size_t hash_idx = 0;
-            hash_t last_hash = 0;
-            for (size_t bucket_idx = 0; bucket_idx < bucket_count; ++bucket_idx)
-            {
-                auto &bucket = hash_lookup_table[bucket_idx];
-                bucket.first = hash_idx;
-                while (true)
-                {
-                    if (hash_idx >= hash_array.size())
-                        break;
-                    hash_t hash = hash_array[hash_idx].kmer;
-                    assert(hash >= last_hash);
-                    const size_t hash_bucket = hash >> hash_lookup_shift;
-                    if (hash_bucket != bucket_idx)
-                        break;
-                    
-                    ++hash_idx;
-                    last_hash = hash;
-                }
-                bucket.second = hash_idx;
-                //LOG("bucket " << bucket_idx << " " << (bucket.second - bucket.first) << " members, range " << bucket.first << " - " << bucket.second);
-            }
-        }
+	typedef KmerSearch<KmerTax, hash_t> Search;
+	std::unique_ptr<Search> search;
 
-        int find_hash(hash_t hash, int default_value) const
-        {
-            hash_t bucket_idx = hash >> hash_lookup_shift;
-            auto &bucket = hash_lookup_table[bucket_idx];
-            auto first = hash_array.begin() + bucket.first;
-            auto last = hash_array.begin() + bucket.second;
-            first = std::lower_bound(first, last, KmerTax(hash, 0));
-            return ((first == last) || (hash < first->kmer) ) ? default_value : first->tax_id;
-        }
+	std::unique_ptr<MismatchIndex> mismatch_index;
 
-		Hits operator() (const std::string &seq) const 
+	// saved_as - db the mismatch index is stored next to, empty if it should not be stored
+	void build_search(const std::string &saved_as = std::string())
+	{
+		search.reset(new Search(hash_array.begin(), hash_array.size(), kmer_len, config.search_layout));
+		if (config.mismatches > 0)
+			build_mismatch_index(saved_as);
+	}
+
+	void build_mismatch_index(const std::string &saved_as)
+	{
+		mismatch_index.reset(new MismatchIndex(kmer_len, config.mismatches));
+		if (!saved_as.empty() && mismatch_index->load(saved_as, hash_array.begin(), hash_array.size()))
 		{
-			Hits hits;
-			Hash<hash_t>::for_all_hashes_do(seq, kmer_len, [&](hash_t hash)
-				{
-					if (auto tax_id = get_db_tax(hash))
-					{
-						hits[tax_id] ++;
-//						LOG(tax_id << " " << Hash<hash_t>::str_from_hash(hash, KMER_LEN));
-					}
+			LOG("mismatch index loaded (" << mismatch_index->copies() << " copies)");
+			return;
+		}
 
-					return true;
-				});
+		LOG("building mismatch index (" << mismatch_index->copies() << " copies)");
+		mismatch_index->build(hash_array.begin(), hash_array.size());
+		if (saved_as.empty())
+			return;
 
-			return hits;
+		try
+		{
+			mismatch_index->save(saved_as);
+			LOG("mismatch index saved");
 		}
+		catch (std::exception &e)
+		{
+			LOG("cannot save mismatch index: " << e.what());
+		}
+	}
 
-		tax_t get_db_tax(hash_t hash) const
+	struct Matcher // Job::run makes a copy per thread
+	{
+		const Search &search;
+		const MismatchIndex *mismatch_index; // kmers not found exactly are looked up here, if any
+		int kmer_len;
+		std::vector<tax_t> found_taxes; // reused from read to read
+		Matcher(const Search &search, const MismatchIndex *mismatch_index, int kmer_len) : search(search), mismatch_index(mismatch_index), kmer_len(kmer_len) {}
+
+		Hits operator() (const p_string &seq)
 		{
-			auto tax_id = get_db_tax_0_variations(hash);
-#if 0
-			if (tax_id)
-				return tax_id;
-			
-			seq_transform<hash_t>::for_all_1_char_variations_do(hash, KMER_LEN, [&](hash_t hash)
+			found_taxes.clear();
+			search.find_all_kmers(seq.s, seq.len, [&](const KmerTax *found, hash_t hash)
 				{
-					hash = seq_transform<hash_t>::min_hash_variant(hash, KMER_LEN);
-					tax_id = find_hash(hash, 0);
-					return !tax_id;
-				});
+					tax_t tax_id = found ? found->tax_id : 0;
+					if (!found && mismatch_index)
+						tax_id = mismatch_index->find(hash);
 
-			if (tax_id)
-				return tax_id;
+					if (tax_id)
+						found_taxes.push_back(tax_id);
 
-			seq_transform<hash_t>::for_all_2_char_variations_do(hash, KMER_LEN, [&](hash_t hash)
-				{
-					hash = seq_transform<hash_t>::min_hash_variant(hash, KMER_LEN);
-					tax_id = find_hash(hash, 0);
-					return !tax_id;
+					return true;
 				});
 
-			if (tax_id)
-				return tax_id;
+			std::sort(found_taxes.begin(), found_taxes.end());
 
-			seq_transform<hash_t>::for_all_3_char_variations_do(hash, KMER_LEN, [&](hash_t hash)
-				{
-					hash = seq_transform<hash_t>::min_hash_variant(hash, KMER_LEN);
-					tax_id = find_hash(hash, 0);
-					return !tax_id;
-				});
-#endif
-			return tax_id;
-		}
+			Hits hits;
+			for (size_t from = 0, to = 0; from < found_taxes.size(); from = to)
+			{
+				while (to < found_taxes.size() && found_taxes[to] == found_taxes[from])
+					to++;
 
-		tax_t get_db_tax_0_variations(hash_t hash) const
-		{
-			hash = seq_transform<hash_t>::min_hash_variant(hash, kmer_len);
-            return find_hash(hash, 0);
+				hits.add(found_taxes[from], int(to - from));
+			}
+
+			return hits;
 		}
 	};
 
@@ -201,11 +205,18 @@ public:
         const bool print_counts;
 		TaxPrinter(std::ostream &out_f, bool print_counts) : out_f(out_f), print_counts(print_counts) {}
 
-		void operator() (const std::vector<Reader::Fragment> &processing_sequences, const std::vector<TaxMatchId> &ids)
+		void operator() (const Reader::Chunk &processing_sequences, const std::vector<TaxMatchId> &ids)
+		{
+			(*this)(out_f, processing_sequences, ids);
+		}
+
+		void operator() (std::ostream &out_f, const Reader::Chunk &processing_sequences, const std::vector<TaxMatchId> &ids) const
 		{
 			for (auto seq_id : ids)
 			{
-                for (auto c : processing_sequences[seq_id.seq_id].spotid) {
+                auto spotid = processing_sequences.spotid(seq_id.seq_id);
+                for (int i = 0; i < spotid.len; i++) {
+                    auto c = spotid.s[i];
                     if (c == '\t' || c == '\n') {
                         c = ' ';
                     }
@@ -221,11 +232,11 @@ public:
         }
 	};
 
-	virtual void run(const std::string &filename, std::ostream &out_f)
+	virtual Stats run(const std::string &filename, std::ostream &out_f)
 	{
-		Matcher m(hash_array, kmer_len);
+		Matcher m(*search, mismatch_index.get(), kmer_len);
 		TaxPrinter print(out_f, !config.hide_counts);
-		Job::run<Matcher, TaxPrinter, TaxMatchId>(filename, print, m, kmer_len, config.spot_filter_file, config.unaligned_only);
+		return Job::run<Matcher, TaxPrinter, TaxMatchId>(filename, print, m, kmer_len, config.spot_filter_file, config.unaligned_only, config.ordered_output);
 	}
 };
 
@@ -234,6 +245,7 @@ struct DBSBasicJob : public DBSJob
 	DBSBasicJob(const Config &config) : DBSJob(config)
 	{
 		kmer_len = DBSIO::load_dbs(config.dbs, hash_array);
+		build_search(config.dbs);
 	}
 };
 
@@ -28,23 +28,22 @@
 #define ALIGNS_TO_DBSS_JOB_H_INCLUDED
 
 #include "aligns_to_dbs_job.h"
+#include "kway_merge.h"
 #include <set>
 
 struct DBSSJob : public DBSJob
 {
 	DBSSJob(const Config &config) : DBSJob(config)
 	{
-		DBSIO::DBSHeader header;
-
 	    std::ifstream f(config.dbss, std::ios::binary | std::ios::in);
 	    if (f.fail() || f.eof())
 		    throw std::runtime_error(std::string("cannot open dbss ") + config.dbss);
 
-		IO::read(f, header);
-		kmer_len = header.kmer_len;
+		auto layout = DBSIO::load_layout(f, sizeof(hash_t));
+		kmer_len = layout.kmer_len;
 
 		DBSAnnotation annotation;
-		auto sum_offset = load_dbs_annotation(config.dbss + ".annotation", annotation);
+		auto sum_offset = load_dbs_annotation(config.dbss + ".annotation", annotation, layout.data_offset);
 		if (sum_offset != IO::filesize(config.dbss))
 			throw std::runtime_error("inconsistent dbss annotation file");
 
@@ -53,6 +52,7 @@ struct DBSSJob : public DBSJob
 			throw std::runtime_error("empty tax list");
 
 		load_dbss(config.dbss, tax_list, annotation);
+		build_search();
 	}
 
 	typedef unsigned int tax_id_t;
@@ -73,13 +73,13 @@ struct DBSSJob : public DBSJob
 	typedef std::vector<DBSAnnot> DBSAnnotation;
 	typedef std::vector<tax_id_t> TaxList;
 
-	static size_t load_dbs_annotation(const std::string &filename, DBSAnnotation &annotation)
+	static size_t load_dbs_annotation(const std::string &filename, DBSAnnotation &annotation, size_t data_offset)
 	{
 		std::ifstream f(filename);
 		if (f.fail())
 			throw std::runtime_error("cannot open annotation file");
 
-		size_t offset = sizeof(DBSIO::DBSHeader) + sizeof(size_t);
+		size_t offset = data_offset;
 		tax_id_t prev_tax = 0;
 
 		while (!f.eof())
@@ -130,36 +130,40 @@ struct DBSSJob : public DBSJob
 	{
         assert(hash_array.empty());
 
-        std::ifstream f(filename);
-        if (f.fail() || f.eof())
-            throw std::runtime_error("cannot open dbss file");
-        
+        MappedFile dbss(filename);
+
+        // slices of the selected taxes are sorted by sort_dbs, so they are merged, not sorted
+        // merge is stable and runs go in increasing tax order, so a kmer shared by several selected taxes
+        // comes first with the lowest tax id and lookups return that one, the std::sort used before ordered such kmers arbitrarily
+        std::vector<SortedRun<hash_t>> runs;
+        std::vector<tax_id_t> run_tax;
         size_t total_hashes_count = 0;
+        auto annot = annotation.begin();
         for (auto tax_id : tax_list) {
-            for (auto& annot : annotation) {
-                if (annot.tax_id == tax_id) {
-                    total_hashes_count += annot.count;
-                }
-            }
-        }
-        hash_array.reserve(total_hashes_count);
-        
-        for (auto tax_id : tax_list) {
-            for (auto& annot : annotation) {
-                if (annot.tax_id == tax_id && annot.count > 0) {
-                    std::vector<hash_t> hashes;
-                    IO::load_vector_no_size(f, hashes, annot.offset, annot.count);
-                    for (auto hash : hashes) {
-                        hash_array.emplace_back(hash, annot.tax_id);
-                    }
-                }
-            }
+            annot = std::lower_bound(annot, annotation.end(), DBSAnnot(tax_id, 0, 0));
+            if (annot == annotation.end() || annot->tax_id != tax_id)
+                continue;
+
+            if (annot->offset + annot->count * sizeof(hash_t) > dbss.size())
+                throw std::runtime_error("dbss file is shorter than annotation");
+
+            auto first = (const hash_t*)(dbss.data() + annot->offset);
+            runs.push_back(SortedRun<hash_t>(first, first + annot->count));
+            run_tax.push_back(annot->tax_id);
+            total_hashes_count += annot->count;
+            annot++; // each tax once
         }
-        assert(hash_array.size() == total_hashes_count);
-        
-        LOG("dbss parts loaded (" << (total_hashes_count / 1000 / 1000) << "m kmers)");
-        assert(!hash_array.empty());
-        std::sort(hash_array.begin(), hash_array.end());
+
+        LOG("dbss parts found (" << runs.size() << " parts, " << (total_hashes_count / 1000 / 1000) << "m kmers)");
+        assert(total_hashes_count > 0);
+
+        std::vector<KmerTax> kmers(total_hashes_count);
+        kway_merge(runs, kmers.data(), [&](hash_t hash, size_t run)
+            {
+                return KmerTax(hash, run_tax[run]);
+            });
+
+        hash_array.assign(std::move(kmers));
         LOG("dbss parts merged");
 	}
 };
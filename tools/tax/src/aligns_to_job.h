@@ -30,8 +30,15 @@
 #include <time.h>
 #include <thread>
 #include "log.h"
+#include "omp_adapter.h"
 #include "reader.h"
 #include "fasta_reader.h"
+#include "fastq_reader.h"
+#include "ordered_writer.h"
+#include <sstream>
+#include <memory>
+#include <mutex>
+#include <exception>
 
 struct BasicMatchId
 {
@@ -46,71 +53,128 @@ struct BasicPrinter
 	std::ostream &out_f;
 	BasicPrinter(std::ostream &out_f) : out_f(out_f){}
 
-	void operator() (const std::vector<Reader::Fragment> &processing_sequences, const std::vector<BasicMatchId> &ids)
+	void operator() (const Reader::Chunk &processing_sequences, const std::vector<BasicMatchId> &ids)
+	{
+		(*this)(out_f, processing_sequences, ids);
+	}
+
+	void operator() (std::ostream &out_f, const Reader::Chunk &processing_sequences, const std::vector<BasicMatchId> &ids) const
 	{
 		for (auto seq_id : ids)
-			out_f << processing_sequences[seq_id.seq_id].spotid << std::endl;
+			out_f << processing_sequences.spotid(seq_id.seq_id) << std::endl;
 	}
 };
 
 struct Job
 {
-	virtual void run(const std::string &contig_filename, std::ostream &out_f) = 0;
+	struct Stats // of one input
+	{
+		size_t spot_count, read_count, matched_count;
+		Stats() : spot_count(0), read_count(0), matched_count(0) {}
+	};
 
+	virtual Stats run(const std::string &contig_filename, std::ostream &out_f) = 0;
+
+	// locks are per call, so that several inputs can be processed at once
 	template <class Matcher, class Printer, class MatchId = BasicMatchId>
-	static void run(const std::string &contig_filename, Printer &print, Matcher &matcher, size_t min_sequence_len, const std::string &spot_filter_file, bool unaligned_only)
+	static Stats run(const std::string &contig_filename, Printer &print, Matcher &matcher, size_t min_sequence_len, const std::string &spot_filter_file, bool unaligned_only, bool ordered_output = false)
 	{
-		Progress progress;
+		// inputs of a batch are processed at once, so their lines are told apart by the input name
+		const std::string label = omp_in_parallel() ? contig_filename + ": " : std::string();
+		Progress progress(label);
         Reader::Params params;
         params.filter_file = spot_filter_file;
         params.split_non_atgc = true;
         params.unaligned_only = unaligned_only;
         auto reader = Reader::create(contig_filename, params);
 
+        // ordered output: chunks are numbered when read, formatted by their threads and written in input order by a single writer
+        std::unique_ptr<OrderedWriter> writer;
+        if (ordered_output)
+            writer.reset(new OrderedWriter(print.out_f, 4 * omp_get_max_threads()));
+
+        size_t chunks_read = 0;
+        size_t matched_count = 0;
+        std::mutex read_mutex, output_mutex;
+        std::exception_ptr error; // first error of the threads, under read_mutex, others stop reading
+
         #pragma omp parallel
         {
+            Matcher thread_matcher(matcher); // matchers keep per thread buffers
             std::vector<MatchId> matched_ids;
-            std::vector<Reader::Fragment> chunk;
+            Reader::Chunk chunk; // matchers get bases right from the chunk buffer
+            std::ostringstream chunk_out;
+            size_t thread_matched_count = 0;
             bool done = false;
             while (!done) {
-                #pragma omp critical (read)
-                {
-                    done = !reader->read_many(chunk);
-                    progress.report(reader->progress());
-                }
+                try {
+                    size_t chunk_seq;
+                    {
+                        std::lock_guard<std::mutex> lock(read_mutex);
+                        if (error) {
+                            break;
+                        }
+                        done = !reader->read_chunk(chunk, Reader::DEFAULT_CHUNK_SIZE);
+                        chunk_seq = chunks_read++;
+                        progress.report(reader->progress());
+                    }
 
-                matched_ids.clear();
-                for (size_t seq_id = 0; seq_id < chunk.size(); ++seq_id) {
-                    auto& spotid = chunk[seq_id].spotid;
-                    auto& bases = chunk[seq_id].bases;
-                    //processed_spots.insert(spotid);
-                    if (bases.size() >= min_sequence_len) {
-                        if (auto m = matcher(bases)) {
-                            //identified_spots.insert(spotid);
-                            matched_ids.push_back(MatchId(seq_id, m));
+                    matched_ids.clear();
+                    for (size_t seq_id = 0; seq_id < chunk.size(); ++seq_id) {
+                        auto bases = chunk.bases(seq_id);
+                        if (size_t(bases.len) >= min_sequence_len) {
+                            if (auto m = thread_matcher(bases)) {
+                                //identified_spots.insert(spotid);
+                                matched_ids.push_back(MatchId(seq_id, m));
+                            }
                         }
                     }
-                }
 
-                #pragma omp critical (output)
-                {
-                    print(chunk, matched_ids);
+                    thread_matched_count += matched_ids.size();
+                    if (writer) {
+                        chunk_out.str(std::string());
+                        print(chunk_out, chunk, matched_ids);
+                        writer->put(chunk_seq, chunk_out.str());
+                    } else {
+                        std::lock_guard<std::mutex> lock(output_mutex);
+                        print(chunk, matched_ids);
+                    }
+                } catch (...) {
+                    // exceptions must not leave the parallel region
+                    {
+                        std::lock_guard<std::mutex> lock(read_mutex);
+                        if (!error) {
+                            error = std::current_exception();
+                        }
+                    }
+                    if (writer) {
+                        writer->abort(); // releases threads waiting for the chunk which will never come
+                    }
+                    break;
                 }
             }
 
+            #pragma omp atomic
+            matched_count += thread_matched_count;
         }
 
+        if (error)
+            std::rethrow_exception(error);
+
+        if (writer)
+            writer->finish();
+
         progress.report(1, true); // always report 100%, needed by pipeline for proper progress report
 
         Reader::SourceStats total_stats;
         if (unaligned_only) {
             auto unaligned_stats = reader->stats();
-            LOG("unaligned spot count: " << unaligned_stats.spot_count);
-            LOG("unaligned read count: " << unaligned_stats.frag_count());
+            LOG(label << "unaligned spot count: " << unaligned_stats.spot_count);
+            LOG(label << "unaligned read count: " << unaligned_stats.frag_count());
         
             Reader::Params total_params;
             total_params.thread_count = 0;
-            if (FastaReader::is_fasta(contig_filename)) {
+            if (FastaReader::is_fasta(contig_filename) || FastqReader::is_fastq(contig_filename)) {
                 total_stats = unaligned_stats;
             } else {
                 total_stats = Reader::create(contig_filename, total_params)->stats();
@@ -119,8 +183,14 @@ struct Job
             total_stats = reader->stats();
         }
         
-        LOG("total spot count: " << total_stats.spot_count);
-        LOG("total read count: " << total_stats.frag_count());
+        LOG(label << "total spot count: " << total_stats.spot_count);
+        LOG(label << "total read count: " << total_stats.frag_count());
+
+        Stats stats;
+        stats.spot_count = total_stats.spot_count;
+        stats.read_count = total_stats.frag_count();
+        stats.matched_count = matched_count;
+        return stats;
 	}
 
 	virtual size_t db_kmers() const { return 0;}
@@ -128,9 +198,10 @@ struct Job
 private:
 	struct Progress
 	{
+        std::string label;
         time_t last_timestamp;
 		int last_reported;
-		Progress() : last_timestamp(0), last_reported(-1) {}
+		Progress(const std::string &label) : label(label), last_timestamp(0), last_reported(-1) {}
 
 		void report(float progress, bool force = false)
 		{
@@ -139,7 +210,7 @@ private:
             if (percent != last_reported) {
                 auto timestamp = time(nullptr);
                 if (force || (timestamp > last_timestamp + 5)) {
-                    LOG(percent << "% processed");
+                    LOG(label << percent << "% processed");
                     last_reported = percent;
                     last_timestamp = timestamp;
                 }
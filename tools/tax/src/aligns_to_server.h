@@ -0,0 +1,222 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#ifndef ALIGNS_TO_SERVER_H_INCLUDED
+#define ALIGNS_TO_SERVER_H_INCLUDED
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <climits>
+#include <stdexcept>
+#include "log.h"
+#include "aligns_to_job.h"
+#if ! _WINDOWS
+#include <unistd.h>
+#include "unix_socket.h"
+#endif
+
+// resident aligns_to: database is loaded once, requests come through a local socket one at a time
+// request starts with a line:
+//    file <fasta or accession>   - input as seen by server
+//    fasta                       - inline fasta follows till the end of request
+//    stop                        - server exits
+// response is the usual aligns_to output followed by a status line:
+//    #done <spots> <reads> <matched reads>
+//    #error <message>
+#if ! _WINDOWS
+struct AlignsToServer
+{
+	static void serve(Job &job, const std::string &socket_path)
+	{
+		auto listener = UnixSocket::listen(socket_path);
+		LOG("listening on " << socket_path);
+		while (true)
+		{
+			auto client = listener.accept();
+			if (!handle(job, client))
+				break;
+		}
+
+		unlink(socket_path.c_str());
+		LOG("server stopped");
+	}
+
+	// input: fasta or accession, "-" for fasta from stdin, empty to stop server
+	// returns exit code
+	static int request(const std::string &socket_path, const std::string &input)
+	{
+		auto server = UnixSocket::connect(socket_path);
+		SocketStreambuf buf(server);
+		std::ostream out(&buf);
+		if (input.empty())
+			out << "stop" << std::endl;
+		else if (input == "-")
+		{
+			out << "fasta" << std::endl;
+			char chunk[64 * 1024];
+			while (std::cin.read(chunk, sizeof(chunk)) || std::cin.gcount() > 0)
+				out.write(chunk, std::cin.gcount());
+		}
+		else
+			out << "file " << absolute_path(input) << std::endl;
+
+		out.flush();
+		if (!out)
+			throw std::runtime_error("cannot send request to " + socket_path);
+
+		server.shutdown_send();
+
+		std::istream in(&buf);
+		std::string line, status;
+		bool has_line = false;
+		while (std::getline(in, line))
+		{
+			if (has_line)
+				std::cout << status << std::endl;
+
+			status = line;
+			has_line = true;
+		}
+
+		if (starts_with(status, done()))
+		{
+			LOG("done" << status.substr(done().size()));
+			return 0;
+		}
+
+		if (has_line && !starts_with(status, error()))
+			std::cout << status << std::endl;
+
+		LOG("request failed: " << (starts_with(status, error()) ? status.substr(error().size() + 1) : std::string("no response status")));
+		return 1;
+	}
+
+private:
+	static const std::string &done() { static const std::string s = "#done"; return s; }
+	static const std::string &error() { static const std::string s = "#error"; return s; }
+
+	static bool starts_with(const std::string &s, const std::string &prefix)
+	{
+		return s.compare(0, prefix.size(), prefix) == 0;
+	}
+
+	// relative paths are resolved by client, accessions are passed as is
+	static std::string absolute_path(const std::string &input)
+	{
+		char path[PATH_MAX];
+		if (realpath(input.c_str(), path))
+			return path;
+
+		return input;
+	}
+
+	// inline fasta is spooled to a temporary file, so that it goes through the usual reader
+	struct TempFasta
+	{
+		std::string filename;
+
+		TempFasta(std::istream &in)
+		{
+			const char *dir = getenv("TMPDIR");
+			filename = std::string(dir && *dir ? dir : "/tmp") + "/aligns_to_XXXXXX.fasta";
+			int fd = mkstemps(&filename[0], 6);
+			if (fd < 0)
+				throw std::runtime_error("cannot create temporary file " + filename);
+
+			close(fd);
+			std::ofstream f(filename, std::ios::binary);
+			char chunk[64 * 1024];
+			while (in.read(chunk, sizeof(chunk)) || in.gcount() > 0)
+				f.write(chunk, in.gcount());
+
+			if (!f)
+				throw std::runtime_error("cannot write temporary file " + filename);
+		}
+
+		~TempFasta() { unlink(filename.c_str()); }
+	};
+
+	// returns false on stop request
+	static bool handle(Job &job, UnixSocket &client)
+	{
+		SocketStreambuf buf(client);
+		std::istream in(&buf);
+		std::ostream out(&buf);
+		std::string command;
+		std::getline(in, command);
+		LOG("request: " << command);
+		if (command == "stop")
+		{
+			out << done() << std::endl;
+			return false;
+		}
+
+		try
+		{
+			Job::Stats stats;
+			if (starts_with(command, "file "))
+				stats = job.run(command.substr(5), out);
+			else if (command == "fasta")
+			{
+				TempFasta fasta(in);
+				stats = job.run(fasta.filename, out);
+			}
+			else
+				throw std::runtime_error("unknown request: " + command);
+
+			out << done() << " " << stats.spot_count << " " << stats.read_count << " " << stats.matched_count << std::endl;
+		}
+		catch (std::exception &e)
+		{
+			LOG("request failed: " << e.what());
+			out << error() << " " << e.what() << std::endl;
+		}
+
+		if (!out)
+			LOG("client has gone before the response was sent");
+
+		return true;
+	}
+};
+#else
+// unix domain sockets are not available, config rejects -server and -client
+struct AlignsToServer
+{
+	static void serve(Job &, const std::string &)
+	{
+		throw std::runtime_error("-server is not supported on this platform");
+	}
+
+	static int request(const std::string &, const std::string &)
+	{
+		throw std::runtime_error("-client is not supported on this platform");
+	}
+};
+#endif
+
+#endif
@@ -118,15 +118,35 @@ public:
         }
         return false;
     }
+
+    bool read_chunk(Chunk& chunk, size_t max_count) override {
+        std::string spotid;
+        while (reader.read_chunk(chunk, max_count)) {
+            size_t kept = 0;
+            for (auto& entry : chunk.entries) {
+                spotid.assign(chunk.data, entry.spotid, entry.spotid_len);
+                if (filter.is_good(spotid)) {
+                    chunk.entries[kept++] = entry;
+                }
+            }
+            chunk.entries.resize(kept);
+            if (!chunk.empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
 };
 
 // splits reads by non-atgs values
+// read and read_chunk keep separate state, use only one of them
 template <typename ReaderType>
 class SplittingReader final: public Reader {
 private:
     ReaderType reader;
     Fragment last;
     size_t offset;
+    std::vector<Chunk::Entry> split; // pieces point to bases in chunk data
     
 public:
     template <typename... ReaderArgs>
@@ -164,6 +184,33 @@ public:
             }
         }
     }
+
+    bool read_chunk(Chunk& chunk, size_t max_count) override {
+        while (reader.read_chunk(chunk, max_count)) {
+            split.clear();
+            for (auto& entry : chunk.entries) {
+                const char* bases = chunk.data.data() + entry.bases;
+                const char* end = bases + entry.bases_len;
+                if (std::find_if(bases, end, non_actg) == end) { // kept as is, like read does
+                    split.push_back(entry);
+                    continue;
+                }
+                for (const char* from = std::find_if(bases, end, is_actg); from != end; ) {
+                    const char* to = std::find_if(from, end, non_actg);
+                    Chunk::Entry piece = entry;
+                    piece.bases = entry.bases + (from - bases);
+                    piece.bases_len = int(to - from);
+                    split.push_back(piece);
+                    from = std::find_if(to, end, is_actg);
+                }
+            }
+            std::swap(chunk.entries, split);
+            if (!chunk.empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
 };
 
 // cuts reads at first non-atgc value, consumes empty reads
@@ -197,4 +244,23 @@ public:
             return res;
         }
     }
+
+    bool read_chunk(Chunk& chunk, size_t max_count) override {
+        while (reader.read_chunk(chunk, max_count)) {
+            size_t kept = 0;
+            for (auto& entry : chunk.entries) {
+                const char* bases = chunk.data.data() + entry.bases;
+                auto it = std::find_if(bases, bases + entry.bases_len, non_actg);
+                if (it != bases) {
+                    chunk.entries[kept] = entry;
+                    chunk.entries[kept++].bases_len = int(it - bases);
+                }
+            }
+            chunk.entries.resize(kept);
+            if (!chunk.empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
 };
@@ -27,20 +27,25 @@
 #include <iostream>
 #include <chrono>
 #include <thread>
-#include <array>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <numeric>
 #include "omp_adapter.h"
 #include "kmers.h"
 #include "kmer_io.h"
-#include "kmer_hash.h"
+#include "window_minimizer.h"
 #include "ready_seq.h"
 #include "filename_meta.h"
 #include "config_build_index.h"
 #include "file_list_loader.h"
+#include "dbs.h"
+#include "kway_merge.h"
 
 using namespace std;
 using namespace std::chrono;
 
-const string VERSION = "0.35";
+const string VERSION = "0.39";
 
 size_t weight(size_t kmers_count)
 {
@@ -63,105 +68,82 @@ int calculate_window_size(size_t filesize, bool eukaryota, bool virus, int windo
 	return std::max(min_window_size, calculate_window_size_(filesize, eukaryota, virus) / window_divider);
 }
 
-void process_window(Kmers &kmers, const char *s, int len, tax_id_t tax_id, int kmer_len)
+// chosen kmer of every window is added to window_kmers
+void process_clean_string(std::vector<hash_t> &window_kmers, p_string p_str, int window_size, int kmer_len)
 {
-	if (len < kmer_len)
-		return;
-
-	const int THREADS = 16;
-	struct ThreadFinding
+	WindowMinimizer::for_all_windows_do(p_str.s, p_str.len, window_size, kmer_len, [&](hash_t kmer, int)
 	{
-		KmerHash::hash_of_hash_t min_hash;
-		int has_kmer_pos, min_hash_pos;
-		ThreadFinding() : min_hash(std::numeric_limits<size_t>::max()), has_kmer_pos(-1), min_hash_pos(-1){}
-	};
+		window_kmers.push_back(kmer);
+	});
+}
+
+// one file per thread, chosen kmers go to the shared table in batches
+size_t add_kmers(Kmers &kmers, const string &filename, tax_id_t tax_id, int window_size, int kmer_len)
+{
+	Fasta fasta(filename);
 
-	array<ThreadFinding, THREADS> thread_findings;
-	bool has_kmer_found = false;
+	const size_t BATCH = 64*1024;
+	size_t total_size = 0;
+	std::vector<hash_t> window_kmers;
 
-	#pragma omp parallel num_threads(THREADS)
-	for (int i = omp_get_thread_num(); !has_kmer_found && i <= len - kmer_len; i += omp_get_num_threads())
+	ReadySeq seq;
+	while (true)
 	{
-		hash_t kmer = KmerIO::kmer_from(s, i, kmer_len);
-
-		auto thread_id = omp_get_thread_num();
+		load_sequence(&fasta, &seq);
+		if (seq.seq.empty())
+			break;
 
-		auto h = KmerHash::hash_of(kmer); // todo: can be optimized
+		total_size += seq.seq.size();
+		for (auto &clean_string : seq.clean_strings)
+			process_clean_string(window_kmers, clean_string, window_size, kmer_len);
 
-		if (h < thread_findings[thread_id].min_hash)
+		if (window_kmers.size() >= BATCH)
 		{
-			thread_findings[thread_id].min_hash = h;
-			thread_findings[thread_id].min_hash_pos = i;
+			kmers.add_kmers(window_kmers, tax_id);
+			window_kmers.clear();
 		}
 	}
 
-	int chosen_kmer_pos = -1;
-
-	{
-		auto min_hash = thread_findings[0].min_hash;
-		int min_hash_pos = thread_findings[0].min_hash_pos;
-
-		for (int i=1; i<THREADS; i++)
-			if (thread_findings[i].min_hash < min_hash)
-			{
-				min_hash = thread_findings[i].min_hash;
-				min_hash_pos = thread_findings[i].min_hash_pos;
-			}
-
-		chosen_kmer_pos = min_hash_pos;
-
-		if (chosen_kmer_pos < 0)
-			throw std::runtime_error("cannot find min hash");
-	}
-
-	kmers.add_kmer(KmerIO::kmer_from(s, chosen_kmer_pos, kmer_len), tax_id);
+	kmers.add_kmers(window_kmers, tax_id);
+	return total_size;
 }
 
-void process_clean_string(Kmers &kmers, p_string p_str, int window_size, tax_id_t tax_id, int kmer_len)
+struct KmerTax : public DBS::KmerTax
 {
-	for (int start = 0; start <= p_str.len - window_size; start += window_size)
-    {
-        int from = std::max(0, start - (kmer_len - 1));
-        int to = std::min(start + window_size, p_str.len);
-		process_window(kmers, p_str.s + from, to - from, tax_id, kmer_len);
-    }
-}
+	KmerTax(hash_t kmer = 0, tax_id_t tax_id = 0) : DBS::KmerTax(kmer, tax_id) {}
+	bool operator < (const KmerTax &x) const { return kmer < x.kmer; }
+};
 
-size_t add_kmers(Kmers &kmers, const string &filename, tax_id_t tax_id, int window_size, int kmer_len)
+// kmers of all but root tax sorted for .db/.dbs, table is emptied on the way
+template <class C, class Convert>
+std::vector<C> sorted_kmers(Kmers &kmers, Convert convert)
 {
-	Fasta fasta(filename);
-
-	size_t seq_index = 0;
-	size_t total_size = 0;
-	const int DOT_INTERVAL = 128;
-
-	ReadySeq loading_seq, processing_seq;
-	load_sequence(&fasta, &processing_seq);
-
-	while (!processing_seq.seq.empty())
+	auto &shards = kmers.shards;
+	std::vector<size_t> offsets(shards.size() + 1, 0);
+	#pragma omp parallel for
+	for (size_t i = 0; i < shards.size(); i++)
+		for (auto &kmer : shards[i].storage)
+			if (kmer.second != TaxIdTree::ROOT)
+				offsets[i + 1]++;
+
+	std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+	std::vector<C> sorted(offsets.back());
+	#pragma omp parallel for schedule(dynamic, 1)
+	for (size_t i = 0; i < shards.size(); i++)
 	{
-		std::thread loading_thread(load_sequence, &fasta, &loading_seq);
-
-		total_size += processing_seq.seq.size();
+		auto out = offsets[i];
+		for (auto &kmer : shards[i].storage)
+			if (kmer.second != TaxIdTree::ROOT)
+				sorted[out++] = convert(kmer.first, kmer.second);
 
-		for (auto &clean_string : processing_seq.clean_strings)
-			process_clean_string(kmers, clean_string, window_size, tax_id, kmer_len);
-
-		seq_index++;
-		if (seq_index % DOT_INTERVAL == 0)
-			cerr << ".";
-
-		loading_thread.join();
-		swap(processing_seq, loading_seq); // todo: move?
+		std::unordered_map<hash_t, tax_id_t>().swap(shards[i].storage);
 	}
 
-	if (seq_index >= DOT_INTERVAL)
-		cerr << endl;
-
-	return total_size;
+	parallel_sort(sorted);
+	return sorted;
 }
 
-
 int main(int argc, char const *argv[])
 {
 	LOG("build_index version " << VERSION);
@@ -173,28 +155,46 @@ int main(int argc, char const *argv[])
 
 	FileListLoader file_list(config.file_list);
 
-	TaxIdTree tax_id_tree;
+	FlatTaxIdTree tax_id_tree;
 	TaxIdTreeLoader::load_tax_id_tree(tax_id_tree, config.tax_parents_file);
 
 	Kmers kmers(tax_id_tree);
 	size_t total_size = 0;
-	for (auto &file_list_element : file_list.files)
+	std::mutex progress_mutex;
+	LOG("threads: " << omp_get_max_threads());
+
+	// big files first, so that they do not end up last on a single thread
+	std::vector<FileListLoader::File> files(file_list.files.begin(), file_list.files.end());
+	std::stable_sort(files.begin(), files.end(), [](const FileListLoader::File &a, const FileListLoader::File &b) { return a.filesize > b.filesize; });
+
+	#pragma omp parallel for schedule(dynamic, 1)
+	for (size_t i = 0; i < files.size(); i++)
 	{
+		auto &file_list_element = files[i];
 		auto window_size = calculate_window_size(file_list_element.filesize, FilenameMeta::is_eukaryota(file_list_element.filename), FilenameMeta::is_virus(file_list_element.filename), config.window_divider, config.min_window_size);
 		auto tax_id = FilenameMeta::tax_id_from(file_list_element.filename);
-		LOG(file_list_element.filesize << "\t" << window_size << "\t" << tax_id << "\t" << file_list_element.filename);
-		total_size += add_kmers(kmers, file_list_element.filename, tax_id, window_size, config.kmer_len);
+		auto file_size = add_kmers(kmers, file_list_element.filename, tax_id, window_size, config.kmer_len);
 		{
+			std::lock_guard<std::mutex> lock(progress_mutex);
+			total_size += file_size;
+			LOG(file_list_element.filesize << "\t" << window_size << "\t" << tax_id << "\t" << file_list_element.filename);
+
 			auto seconds_past = std::chrono::duration_cast<std::chrono::seconds>( high_resolution_clock::now() - before ).count();
 			if (seconds_past < 1)
 				seconds_past = 1;
 
 			size_t megs = total_size/1000000;
-			LOG("processed size " << megs << "M = " << (total_size/1000)/seconds_past << "K/sec, kmers: " << kmers.storage.size()/1000 << "K, compression rate " << total_size/std::max(size_t(1), weight(kmers.storage.size())));
+			auto kmers_count = kmers.size();
+			LOG("processed size " << megs << "M = " << (total_size/1000)/seconds_past << "K/sec, kmers: " << kmers_count/1000 << "K, compression rate " << total_size/std::max(size_t(1), weight(kmers_count)));
 		}
 	}
 
-	KmerIO::print_kmers(kmers, config.kmer_len);
+	if (config.is_dbs())
+		DBSIO::save_dbs(config.out_file, sorted_kmers<KmerTax>(kmers, [](hash_t kmer, tax_id_t tax_id) { return KmerTax(kmer, tax_id); }), config.kmer_len);
+	else if (config.is_db())
+		DBSIO::save_dbs(config.out_file, sorted_kmers<hash_t>(kmers, [](hash_t kmer, tax_id_t) { return kmer; }), config.kmer_len);
+	else
+		KmerIO::print_kmers(kmers, config.kmer_len);
 
 	LOG("total time (min) " << std::chrono::duration_cast<std::chrono::minutes>( high_resolution_clock::now() - before ).count());
 }
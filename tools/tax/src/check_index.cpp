@@ -47,10 +47,8 @@
 using namespace std;
 using namespace std::chrono;
 
-void check_hash(hash_t kmer, int kmer_len, Kmers &kmers, tax_id_t tax_id, list<hash_t> &result_hashes)
+void check_hash(hash_t kmer, int kmer_len, Kmers &kmers, tax_id_t tax_id, list<hash_t> &result_hashes) // kmer is canonical
 {
-	kmer = seq_transform<hash_t>::min_hash_variant(kmer, kmer_len);
-
 	if (kmers.has_kmer_but_not_tax(kmer, tax_id))
 		result_hashes.push_back(kmer);
 }
@@ -72,20 +70,25 @@ void check_clean_string(Kmers &kmers, p_string p_str, tax_id_t tax_id, int kmer_
 	array<ThreadFinding, THREADS> thread_findings;
 
 	#pragma omp parallel num_threads(THREADS)
-	for (int i = omp_get_thread_num(); i <= len - kmer_len; i += omp_get_num_threads())
 	{
 		auto thread_id = omp_get_thread_num();
-
-		auto kmer = Hash<hash_t>::hash_of(s + i, kmer_len);
-		check_hash(kmer, kmer_len, kmers, tax_id, thread_findings[thread_id].hashes);
+		int kmers_count = len - kmer_len + 1;
+		int from = int(size_t(kmers_count) * thread_id / omp_get_num_threads());
+		int to = int(size_t(kmers_count) * (thread_id + 1) / omp_get_num_threads());
+		if (from < to)
+			Hash<hash_t>::for_all_canonical_hashes_do(s + from, to - from + kmer_len - 1, kmer_len, [&](hash_t kmer, int)
+			{
+				check_hash(kmer, kmer_len, kmers, tax_id, thread_findings[thread_id].hashes);
 
 #if 0 // ~ x100 times slower!
-		seq_transform<hash_t>::for_all_1_char_variations_do(kmer, kmer_len, [&](hash_t hash)
-		{
-			check_hash(hash, kmer_len, kmers, tax_id, thread_findings[thread_id].hashes);
-			return true;
-		});
+				seq_transform<hash_t>::for_all_1_char_variations_do(kmer, kmer_len, [&](hash_t hash)
+				{
+					check_hash(hash, kmer_len, kmers, tax_id, thread_findings[thread_id].hashes);
+					return true;
+				});
 #endif
+				return true;
+			});
 	}
 
 	// todo: multithreaded too ?
@@ -179,13 +182,13 @@ int main(int argc, char const *argv[])
 
 	FileListLoader file_list(config.file_list);
 
-	TaxIdTree tax_id_tree;
+	FlatTaxIdTree tax_id_tree;
 	TaxIdTreeLoader::load_tax_id_tree(tax_id_tree, config.tax_parents_file);
 
 	Kmers kmers(tax_id_tree);
 	int kmer_len = load_kmers(kmers, config.kmers_file);
 	LOG("kmer len: " << kmer_len);
-	LOG(kmers.storage.size() << " kmers loaded");
+	LOG(kmers.size() << " kmers loaded");
 
 	size_t total_size = 0;
 	for (auto &file_list_element : file_list.files)
@@ -33,18 +33,30 @@
 #include <list>
 #include <stdexcept>
 #include "log.h"
+#include "kmer_search.h"
 
 struct Config
 {
-	std::string reference, db, dbs, dbss, dbss_tax_list, contig_file, spot_filter_file;
+	std::string reference, db, dbs, dbss, dbss_tax_list, contig_file, spot_filter_file, summary_file;
+	std::string server_socket, client_socket;
 	typedef std::list<std::string> Strings;
 	Strings contig_files;
     bool unaligned_only;
     bool hide_counts;
+    bool ordered_output;
+    int mismatches;
+    int batch; // inputs of the list processed at once
+    bool stop_server;
+    SearchLayout search_layout;
 
 	Config(int argc, char const *argv[])
         : hide_counts(false)
         , unaligned_only(false)
+        , ordered_output(false)
+        , mismatches(0)
+        , batch(1)
+        , stop_server(false)
+        , search_layout(SearchLayout::BUCKET)
 	{
         std::list<std::string> args;
         for (int i = 1; i < argc; ++i) {
@@ -65,11 +77,27 @@ struct Config
                 hide_counts = true;
             } else if (arg == "-unaligned_only") {
                 unaligned_only = true;
+            } else if (arg == "-ordered") {
+                ordered_output = true;
             } else if (arg == "-list") {
                 contig_files = load_list(pop_arg(args));
             } else if (arg == "-spot_filter") {
                 spot_filter_file = pop_arg(args);
-            } else if (arg.empty() || arg[0] == '-' || !contig_file.empty()) {
+            } else if (arg == "-batch") {
+                batch = std::stoi(pop_arg(args));
+            } else if (arg == "-summary") {
+                summary_file = pop_arg(args);
+            } else if (arg == "-server") {
+                server_socket = pop_arg(args);
+            } else if (arg == "-client") {
+                client_socket = pop_arg(args);
+            } else if (arg == "-stop") {
+                stop_server = true;
+            } else if (arg == "-mismatches") {
+                mismatches = std::stoi(pop_arg(args));
+            } else if (arg == "-search") {
+                search_layout = search_layout_from(pop_arg(args));
+            } else if (arg.empty() || (arg[0] == '-' && arg != "-") || !contig_file.empty()) {
                 std::string reason = "unexpected argument: " + arg;
                 fail(reason.c_str());
             } else {
@@ -77,16 +105,49 @@ struct Config
             }
         }
 
-        // exactly one should exist
-        if (contig_file.empty() == contig_files.empty()) { 
-            fail("please provide either contig file or list");
+#if _WINDOWS
+        if (!server_socket.empty() || !client_socket.empty()) {
+            fail("-server and -client are not supported on this platform");
         }
+#endif
 
         int db_count = int(!db.empty()) + int(!dbs.empty()) + int(!dbss.empty());
+        if (!client_socket.empty()) {
+            if (db_count != 0 || !contig_files.empty() || !server_socket.empty() || contig_file.empty() == !stop_server) {
+                fail("-client needs either contig file, - for fasta from stdin or -stop");
+            }
+            return;
+        }
+
+        if (stop_server || contig_file == "-") {
+            fail("-stop and - should be used with -client");
+        }
+
+        // exactly one should exist, server gets them from clients
+        if (!server_socket.empty()) {
+            if (!contig_file.empty() || !contig_files.empty()) {
+                fail("-server gets contig files from clients");
+            }
+        } else if (contig_file.empty() == contig_files.empty()) { 
+            fail("please provide either contig file or list");
+        }
+
         if (db_count != 1) {
             fail("please provide exactly one db argument");
         }
 
+        if (batch < 1) {
+            fail("-batch should be at least 1");
+        }
+
+        if (batch > 1 && contig_files.empty()) {
+            fail("-batch should be used with -list");
+        }
+
+        if (mismatches != 0 && !db.empty()) {
+            fail("-mismatches should be used with -dbs or -dbss");
+        }
+
         // tax list makes sense if and only if dbss specified
         if (dbss.empty() != dbss_tax_list.empty()) {
             fail("-tax_list should be used with -dbss");
@@ -103,11 +164,17 @@ struct Config
 
 	static void print_usage()
 	{
-        LOG("need <database> [-spot_filter <spot or read file>] [-hide_counts] [-unaligned_only] <contig fasta or accession>" << std::endl 
+        LOG("need <database> [-spot_filter <spot or read file>] [-hide_counts] [-unaligned_only] [-ordered] [-mismatches <1-3>] [-search <layout>] [-summary <file>] <contig fasta, fastq (may be gzipped) or accession>" << std::endl
+            << "or the same options with -list <file with contig fastas or accessions> [-batch <inputs at once>]" << std::endl 
+            << "or the same options with -server <socket> instead of contig fasta to keep <database> loaded" << std::endl
+            << "or -client <socket> <contig fasta or accession | - for fasta from stdin> or -client <socket> -stop" << std::endl
             << "where <database> is one of:" << std::endl
             << "-db <database>" << std::endl
             << "-dbs <database +tax>" << std::endl
-            << "-dbss <sorted database +tax> -tax_list <tax_list file>")
+            << "-dbss <sorted database +tax> -tax_list <tax_list file>" << std::endl
+            << "and <layout> is one of bucket (default), interpolation" << std::endl
+            << "-mismatches also counts kmers with up to so many substituted letters, index for -dbs is stored next to it" << std::endl
+            << "-summary writes tab separated stats of every input")
 	}
 
 private:
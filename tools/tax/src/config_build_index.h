@@ -32,12 +32,12 @@
 
 struct ConfigBuildIndex
 {
-	std::string file_list, tax_parents_file;
+	std::string file_list, tax_parents_file, out_file;
 	unsigned int window_divider, kmer_len, min_window_size;
 
 	ConfigBuildIndex(int argc, char const *argv[])
 	{
-		if (argc != 6)
+		if (argc != 6 && argc != 7)
 		{
 			print_usage();
 			exit(1);
@@ -48,11 +48,30 @@ struct ConfigBuildIndex
 		window_divider = std::stoi(std::string(argv[3]));
 		kmer_len = std::stoi(std::string(argv[4]));
         min_window_size = std::stoi(std::string(argv[5]));
+		if (argc == 7)
+		{
+			out_file = std::string(argv[6]);
+			if (!is_dbs() && !is_db())
+			{
+				print_usage();
+				exit(1);
+			}
+		}
 	}
 
+	bool is_dbs() const { return ends_with(out_file, ".dbs"); }
+	bool is_db() const { return ends_with(out_file, ".db"); }
+
 	static void print_usage()
 	{
-        LOG("need <files.list> <tax.parents> <window divider> <kmer len> <min window size>");
+        LOG("need <files.list> <tax.parents> <window divider> <kmer len> <min window size> [<out file>]" << std::endl
+            << "kmers are printed as text unless out file is .dbs (sorted kmers with tax ids) or .db (sorted kmers)");
+	}
+
+private:
+	static bool ends_with(const std::string &s, const std::string &suffix)
+	{
+		return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
 	}
 };
 
@@ -34,8 +34,9 @@
 struct Config
 {
 	std::string fasta_db, out_file;
+	bool filter_low_complexity;
 
-	Config(int argc, char const *argv[])
+	Config(int argc, char const *argv[]) : filter_low_complexity(false)
 	{
 		if (argc < 3)
 		{
@@ -45,11 +46,20 @@ struct Config
 
 		fasta_db = argv[1];
 		out_file = argv[2];
+
+		for (int i = 3; i < argc; i++)
+			if (std::string(argv[i]) == "-filter_low_complexity")
+				filter_low_complexity = true;
+			else
+			{
+				print_usage();
+				exit(1);
+			}
 	}
 
 	static void print_usage()
 	{
-		LOG("need <fasta db> <out file>");
+		LOG("need <fasta db> <out file> [-filter_low_complexity]");
 	}
 
 };
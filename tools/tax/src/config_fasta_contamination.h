@@ -35,6 +35,7 @@ struct Config
 	static void print_usage()
 	{
 		std::cerr << "need <files.list> <dbs>" << std::endl;
+		std::cerr << "files with hits are printed as soon as they are checked, in completion order, not sorted by hit count" << std::endl;
 	}
 
 };
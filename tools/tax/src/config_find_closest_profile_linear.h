@@ -8,7 +8,7 @@
 
 struct Config
 {
-	std::string file_list, profile_file;
+	std::string file_list, profile_file, index_file, store_file;
 	int top_count;
 	int argc;
 	char const **argv;
@@ -21,11 +21,20 @@ struct Config
 		return std::string(argv[index]);
 	}
 
-	Config(int argc, char const *argv[]) : argc(argc), argv(argv)
+	Config(int argc, char const *argv[]) : top_count(0), argc(argc), argv(argv)
 	{
+		if (arg(1) == "-store")
+		{
+			file_list = arg(2);
+			store_file = arg(3);
+			return;
+		}
+
 		file_list = arg(1);
 		profile_file = arg(2);
 		top_count = std::stoi(arg(3));
+		if (argc > 4)
+			index_file = arg(4);
 	}
 
 	void fail() const
@@ -36,7 +45,8 @@ struct Config
 
 	static void print_usage()
 	{
-		std::cerr << "need <files.list> <profile file> <top count>" << std::endl;
+		std::cerr << "need <files.list or .profiles store> <profile file> <top count> [lsh index file, built if missing or out of date]" << std::endl;
+		std::cerr << "or -store <files.list> <.profiles store to save>" << std::endl;
 	}
 
 };
@@ -33,9 +33,11 @@
 
 struct Config
 {
-	std::string input_filename, out_filename;
+	std::string input_filename, out_filename, temp_dir;
+	bool filter_low_complexity;
+	size_t memory_mb;
 
-	Config(int argc, char const *argv[])
+	Config(int argc, char const *argv[]) : filter_low_complexity(false), memory_mb(4096)
 	{
 		if (argc < 3)
 		{
@@ -45,11 +47,35 @@ struct Config
 
 		input_filename = argv[1];
 		out_filename = argv[2];
+
+		for (int i = 3; i < argc; i++)
+		{
+			std::string arg = argv[i];
+			if (arg == "-filter_low_complexity")
+				filter_low_complexity = true;
+			else if (arg == "-memory" && i + 1 < argc)
+				memory_mb = std::stoul(argv[++i]);
+			else if (arg == "-temp_dir" && i + 1 < argc)
+				temp_dir = argv[++i];
+			else
+			{
+				print_usage();
+				exit(1);
+			}
+		}
+
+		if (memory_mb < 1)
+		{
+			print_usage();
+			exit(1);
+		}
 	}
 
 	static void print_usage()
 	{
-        LOG("need <dbs file> <out file>");
+        LOG("need <dbs file> <out file> [-filter_low_complexity] [-memory <MB>] [-temp_dir <dir>]" << std::endl
+            << "-memory limits kmers held in memory, 4096 MB by default, larger input is sorted in runs spilled to temp dir" << std::endl
+            << "-temp_dir is where runs go, next to out file by default");
 	}
 
 };
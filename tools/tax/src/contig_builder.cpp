@@ -10,11 +10,13 @@
 #include "config_contig_builder.h"
 #include <iomanip>
 #include <ctime>
+#include <unordered_map>
+#include <unordered_set>
 
 using namespace std;
 using namespace std::chrono;
 
-const string VERSION = "0.19";
+const string VERSION = "0.20";
 
 typedef std::list<string> Strings;
 
@@ -25,58 +27,6 @@ void print_coverage(const std::vector<int> &cov)
 	cout << endl;
 }
 
-template <class KmerMap>
-typename KmerMap::hash_t restore_orientation(typename KmerMap::hash_t hash, KmerMap &kmers) // todo: remove ?
-{
-	bool orig_complement = false, orig_reverse = false;
-	kmers.get_original_compl_rev(hash, &orig_complement, &orig_reverse);
-	return seq_transform<typename KmerMap::hash_t>::apply_transformation(hash, kmers.kmer_len, orig_reverse, orig_complement);
-}
-
-template <class MainKmerMap>
-Strings build_contigs(MainKmerMap &kmers, int MIN_SEQUENCE_LEN)
-{
-	auto before = high_resolution_clock::now();
-	Begins<MainKmerMap> begins(kmers);
-	LOG("building begins time is (ms) " << std::chrono::duration_cast<std::chrono::milliseconds>( high_resolution_clock::now() - before ).count());
-	LOG("mem usage before build_contigs (G) " << mem_usage()/1000000000);
-
-	typename MainKmerMap::hash_t hash = 0;
-
-	before = high_resolution_clock::now();
-
-	std::chrono::duration<double> perf_begin, perf_contig;
-
-	Strings contigs;
-
-	auto before_loop = high_resolution_clock::now();
-	while (true)
-	{
-		before = high_resolution_clock::now();
-
-		if (!begins.next(&hash))
-			break;
-
-		hash = restore_orientation(hash, kmers);
-
-		perf_begin += high_resolution_clock::now() - before;
-
-		before = high_resolution_clock::now();
-		string contig = ContigBuilder::get_next_contig(kmers, hash);
-
-		if (contig.length() >= MIN_SEQUENCE_LEN)
-			contigs.push_back(contig);
-
-		perf_contig += high_resolution_clock::now() - before;
-	}
-
-	LOG("building contigs time is (ms) " << std::chrono::duration_cast<std::chrono::milliseconds>( high_resolution_clock::now() - before_loop ).count());
-	LOG("perf begin   (ms) " << std::chrono::duration_cast<std::chrono::milliseconds>( perf_begin ).count());
-	LOG("perf contig  (ms) " << std::chrono::duration_cast<std::chrono::milliseconds>( perf_contig ).count());
-
-	return contigs;
-}
-
 template <class KmerMap>
 double percent_of_run(double coverage_sum, const KmerMap &kmers)
 {
@@ -132,7 +82,7 @@ int main(int argc, char const *argv[])
 	KmerLoader loader(kmers, config.unaligned_only, config.filter_file, config.exclude_filter);
 	loader.load(acc);
 
-    Strings contigs_seqs = build_contigs(kmers, config.min_contig_len);
+    Strings contigs_seqs = ContigBuilder::build_contigs(kmers, config.min_contig_len);
     double contig_percent = print_seqs(contigs_seqs, kmers, "_");
 
 	LOG("reported contigs % " << contig_percent);
@@ -16,25 +16,81 @@
 #include "omp_adapter.h"
 
 #include "hash.h"
+#include "seq_transform.h"
+#include "begins.h"
+#include "log.h"
+#include "mem_usage.h"
+#include <unordered_set>
+#include <unordered_map>
 
 struct ContigBuilder
 {
 	static const int MIN_COVERAGE = 2;
 	static const int LAST_LETTERS_COUNT = 4;
 
+	// kmers of the contig are removed from the map as it grows
 	template <class KmerMap>
-	static char choose_next_letter(KmerMap &kmers, typename KmerMap::hash_t *_hash, int min_coverage = MIN_COVERAGE)
+	struct DirectClaims
+	{
+		typedef typename KmerMap::hash_t hash_t;
+		KmerMap &kmers;
+		std::vector<hash_t> used; // canonical
+
+		DirectClaims(KmerMap &kmers) : kmers(kmers) {}
+
+		unsigned int coverage_of(hash_t hash) { return kmers.coverage_of(hash); }
+
+		void remove(hash_t hash)
+		{
+			kmers.remove(hash);
+			used.push_back(seq_transform<hash_t>::min_hash_variant(hash, KmerMap::kmer_len));
+		}
+	};
+
+	// map stays as it is, kmers of the contig are kept aside
+	// seen - kmers present in the map that the contig depends on, see build_contigs
+	template <class KmerMap>
+	struct SpeculativeClaims
+	{
+		typedef typename KmerMap::hash_t hash_t;
+		const KmerMap &kmers;
+		std::unordered_set<hash_t> used; // canonical
+		std::vector<hash_t> seen; // canonical
+
+		SpeculativeClaims(const KmerMap &kmers) : kmers(kmers) {}
+
+		unsigned int coverage_of(hash_t hash)
+		{
+			auto canonical = seq_transform<hash_t>::min_hash_variant(hash, KmerMap::kmer_len);
+			if (used.count(canonical))
+				return 0;
+
+			auto coverage = kmers.get(canonical);
+			if (coverage)
+				seen.push_back(canonical); // absent kmers cannot be taken by other contigs
+			return coverage;
+		}
+
+		void remove(hash_t hash)
+		{
+			auto canonical = seq_transform<hash_t>::min_hash_variant(hash, KmerMap::kmer_len);
+			seen.push_back(canonical);
+			used.insert(canonical);
+		}
+	};
+
+	template <class Claims>
+	static char choose_next_letter(Claims &claims, typename Claims::hash_t *_hash, int kmer_len, int min_coverage = MIN_COVERAGE)
 	{
 		auto hash = *_hash;
 		const char LAST_LETTERS[LAST_LETTERS_COUNT] = {'A', 'C', 'T', 'G'};
-		typename KmerMap::hash_t hashes[LAST_LETTERS_COUNT];
+		typename Claims::hash_t hashes[LAST_LETTERS_COUNT];
 		unsigned int cov[LAST_LETTERS_COUNT]; 
 	
-        #pragma omp parallel for num_threads(LAST_LETTERS_COUNT)
 		for (int i = 0; i < LAST_LETTERS_COUNT; i++)
 		{
-			hashes[i] = Hash<typename KmerMap::hash_t>::hash_next(LAST_LETTERS[i], hash, kmers.kmer_len);
-			cov[i] = kmers.coverage_of(hashes[i]); 
+			hashes[i] = Hash<typename Claims::hash_t>::hash_next(LAST_LETTERS[i], hash, kmer_len);
+			cov[i] = claims.coverage_of(hashes[i]); 
 		}
 
 		int best_letter_index = 0;
@@ -59,24 +115,24 @@ struct ContigBuilder
 		return LAST_LETTERS[best_letter_index];
 	}
 
-	template <class KmerMap>
-	static std::string get_next_contig(KmerMap &kmers, typename KmerMap::hash_t start_from, int min_coverage = MIN_COVERAGE)
+	template <class Claims>
+	static std::string build_contig(Claims &claims, typename Claims::hash_t start_from, int kmer_len, int min_coverage = MIN_COVERAGE)
 	{
-		std::string seq = Hash<typename KmerMap::hash_t>::str_from_hash(start_from, kmers.kmer_len);
+		std::string seq = Hash<typename Claims::hash_t>::str_from_hash(start_from, kmer_len);
 		auto hash = start_from;
-		kmers.remove(hash);
+		claims.remove(hash);
 
 		bool was_reversed = false;
 
 		while (true)
 		{
-			char next_letter = choose_next_letter<KmerMap>(kmers, &hash, min_coverage);
+			char next_letter = choose_next_letter(claims, &hash, kmer_len, min_coverage);
 			if (!next_letter)
 			{
 				if (!was_reversed)
 				{
                     seq_transform_actg::to_rev_complement(seq);
-					hash = seq_transform<typename KmerMap::hash_t>::to_rev_complement(start_from, kmers.kmer_len);
+					hash = seq_transform<typename Claims::hash_t>::to_rev_complement(start_from, kmer_len);
 					was_reversed = true;
 				}
 				else
@@ -87,12 +143,147 @@ struct ContigBuilder
 			}
 			else
 			{
-				kmers.remove(hash);
+				claims.remove(hash);
 				seq += next_letter;
 			}
 		}
 	}
 
+	template <class KmerMap>
+	static std::string get_next_contig(KmerMap &kmers, typename KmerMap::hash_t start_from, int min_coverage = MIN_COVERAGE)
+	{
+		DirectClaims<KmerMap> claims(kmers);
+		return build_contig(claims, start_from, kmers.kmer_len, min_coverage);
+	}
+
+	// kmer as it was added, see KmerMap for which orientation wins
+	template <class KmerMap>
+	static typename KmerMap::hash_t restore_orientation(typename KmerMap::hash_t hash, KmerMap &kmers) // todo: remove ?
+	{
+		bool orig_complement = false, orig_reverse = false;
+		kmers.get_original_compl_rev(hash, &orig_complement, &orig_reverse);
+		return seq_transform<typename KmerMap::hash_t>::apply_transformation(hash, kmers.kmer_len, orig_reverse, orig_complement);
+	}
+
+	// seeds are extended in rounds: in parallel on the unchanged map first, then accepted in the order of seeds
+	// contig is accepted as is unless an earlier contig of the round took a kmer it has seen, then it is built again
+	// so contigs are the same as if seeds were extended one by one, whatever the number of threads
+	template <class MainKmerMap>
+	static std::list<std::string> build_contigs(MainKmerMap &kmers, int MIN_SEQUENCE_LEN, size_t *rebuilt_count = nullptr)
+	{
+		typedef typename MainKmerMap::hash_t hash_t;
+		auto before = std::chrono::high_resolution_clock::now();
+		Begins<MainKmerMap> begins(kmers);
+		LOG("building begins time is (ms) " << std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::high_resolution_clock::now() - before ).count());
+		LOG("mem usage before build_contigs (G) " << mem_usage()/1000000000);
+
+		struct Speculation
+		{
+			hash_t seed, start;
+			std::string contig;
+			std::vector<hash_t> seen, used;
+			bool conflict;
+		};
+
+		const size_t ROUND = 8 * omp_get_max_threads();
+		std::chrono::duration<double> perf_speculative = std::chrono::duration<double>::zero(), perf_accept = std::chrono::duration<double>::zero();
+		size_t accepted = 0, rebuilt = 0;
+
+		std::list<std::string> contigs;
+
+		auto before_loop = std::chrono::high_resolution_clock::now();
+		while (true)
+		{
+			before = std::chrono::high_resolution_clock::now();
+
+			std::vector<Speculation> round;
+			hash_t hash = 0;
+			while (round.size() < ROUND && begins.next(&hash))
+			{
+				round.push_back(Speculation());
+				round.back().seed = hash;
+				round.back().start = restore_orientation(hash, kmers);
+			}
+
+			if (round.empty())
+				break;
+
+			#pragma omp parallel for schedule(dynamic, 1)
+			for (size_t i = 0; i < round.size(); i++)
+			{
+				SpeculativeClaims<MainKmerMap> claims(kmers);
+				round[i].contig = build_contig(claims, round[i].start, kmers.kmer_len);
+				round[i].seen.swap(claims.seen);
+				round[i].used.assign(claims.used.begin(), claims.used.end());
+			}
+
+			std::unordered_map<hash_t, size_t> taken_by; // first contig of the round that took the kmer
+			for (size_t i = 0; i < round.size(); i++)
+				for (auto kmer : round[i].used)
+					taken_by.emplace(kmer, i);
+
+			#pragma omp parallel for schedule(dynamic, 1)
+			for (size_t i = 0; i < round.size(); i++)
+			{
+				round[i].conflict = false;
+				for (auto kmer : round[i].seen)
+				{
+					auto it = taken_by.find(kmer);
+					if (it != taken_by.end() && it->second < i)
+					{
+						round[i].conflict = true;
+						break;
+					}
+				}
+			}
+
+			perf_speculative += std::chrono::high_resolution_clock::now() - before;
+			before = std::chrono::high_resolution_clock::now();
+
+			std::unordered_set<hash_t> taken_by_rebuilt;
+			for (auto &s : round)
+			{
+				if (kmers.get(s.seed) == 0) // taken by an earlier contig
+					continue;
+
+				bool valid = !s.conflict;
+				for (size_t i = 0; valid && !taken_by_rebuilt.empty() && i < s.seen.size(); i++)
+					valid = !taken_by_rebuilt.count(s.seen[i]);
+
+				std::string contig;
+				if (valid)
+				{
+					for (auto kmer : s.used)
+						kmers.remove(kmer);
+
+					contig.swap(s.contig);
+					accepted++;
+				}
+				else
+				{
+					DirectClaims<MainKmerMap> claims(kmers);
+					contig = build_contig(claims, s.start, kmers.kmer_len);
+					taken_by_rebuilt.insert(claims.used.begin(), claims.used.end());
+					rebuilt++;
+				}
+
+				if (contig.length() >= MIN_SEQUENCE_LEN)
+					contigs.push_back(contig);
+			}
+
+			perf_accept += std::chrono::high_resolution_clock::now() - before;
+		}
+
+		LOG("building contigs time is (ms) " << std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::high_resolution_clock::now() - before_loop ).count());
+		LOG("perf speculative (ms) " << std::chrono::duration_cast<std::chrono::milliseconds>( perf_speculative ).count());
+		LOG("perf accept      (ms) " << std::chrono::duration_cast<std::chrono::milliseconds>( perf_accept ).count());
+		LOG("contigs accepted " << accepted << ", rebuilt " << rebuilt);
+		if (rebuilt_count)
+			*rebuilt_count = rebuilt;
+
+		return contigs;
+	}
+
 };
 
 #endif
@@ -56,7 +56,7 @@ void for_all_reads_do(const string &accession, Lambda &&lambda)
     #pragma omp parallel num_threads(THREADS)
 #endif
     {
-        std::vector<Reader::Fragment> chunk;
+        Reader::Chunk chunk;
         bool done = false;
         while (!done) 
         {
@@ -64,29 +64,33 @@ void for_all_reads_do(const string &accession, Lambda &&lambda)
             #pragma omp critical (read)
 #endif
             {
-                done = !reader->read_many(chunk);   
+                done = !reader->read_chunk(chunk, Reader::DEFAULT_CHUNK_SIZE);   
             }
 
 #if 0
-            for (auto& frag: chunk) 
-                lambda(frag.bases);
+            for (size_t i = 0; i < chunk.size(); i++) 
+                lambda(string(chunk.bases(i).s, chunk.bases(i).len));
 #else
             {
                 string spotid;
                 vector<string> spot;
 
-                for (auto& frag: chunk) 
-                    if (frag.spotid == spotid)
-                        spot.push_back(frag.bases);
+                for (size_t i = 0; i < chunk.size(); i++) 
+                {
+                    auto frag_spotid = chunk.spotid(i);
+                    auto frag_bases = chunk.bases(i);
+                    if (spotid.compare(0, string::npos, frag_spotid.s, frag_spotid.len) == 0)
+                        spot.push_back(string(frag_bases.s, frag_bases.len));
                     else
                         {
                             if (!spot.empty())
                                 lambda(spot);
 
                             spot.clear();
-                            spot.push_back(frag.bases);
-                            spotid = frag.spotid;
+                            spot.push_back(string(frag_bases.s, frag_bases.len));
+                            spotid.assign(frag_spotid.s, frag_spotid.len);
                         }
+                }
 
                 if (!spot.empty())
                     lambda(spot);
@@ -38,8 +38,9 @@ using namespace std;
 typedef uint64_t hash_t;
 
 #include "dbs.h"
+#include "low_complexity.h"
 
-const string VERSION = "0.22";
+const string VERSION = "0.24";
 
 string reverse_complement(string s) // yes, by value
 {
@@ -55,7 +56,15 @@ hash_t hash_of(const string &s)
 	return Hash<hash_t>::hash_of(s);
 }
 
-void process_without_taxonomy(const string &fasta_db, const string &out_file)
+template <class C>
+void filter_low_complexity(vector<C> &kmers, int kmer_len)
+{
+	auto total = kmers.size();
+	auto dropped = LowComplexity::filter(kmers, kmer_len);
+	LOG("low complexity kmers dropped: " << dropped << " of " << total);
+}
+
+void process_without_taxonomy(const string &fasta_db, const string &out_file, bool filter)
 {
 	cout << "process without taxonomy info" << endl;
 	TextLoaderSTNoStore loader(fasta_db);
@@ -75,6 +84,9 @@ void process_without_taxonomy(const string &fasta_db, const string &out_file)
 		}
 	}
 
+	if (filter)
+		filter_low_complexity(kmers, kmer_len);
+
 	sort(kmers.begin(), kmers.end());
 	DBSIO::save_dbs(out_file, kmers, kmer_len);
 }
@@ -86,7 +98,7 @@ bool kmer_less(const KmerTax &a, const KmerTax &b)
 	return a.kmer < b.kmer;
 }
 
-void process_with_taxonomy(const string &fasta_db, const string &out_file)
+void process_with_taxonomy(const string &fasta_db, const string &out_file, bool filter)
 {
 	cout << "process with taxonomy info" << endl;
 
@@ -108,6 +120,9 @@ void process_with_taxonomy(const string &fasta_db, const string &out_file)
 		}
 	}
 
+	if (filter)
+		filter_low_complexity(kmers, kmer_len);
+
 	sort(kmers.begin(), kmers.end(), kmer_less);
 	DBSIO::save_dbs(out_file, kmers, kmer_len);
 }
@@ -131,9 +146,9 @@ int main(int argc, char const *argv[])
 	LOG("db_fasta_to_bin version " << VERSION);
 
 	if (has_taxonomy_info(config.fasta_db))
-		process_with_taxonomy(config.fasta_db, config.out_file);
+		process_with_taxonomy(config.fasta_db, config.out_file, config.filter_low_complexity);
 	else
-		process_without_taxonomy(config.fasta_db, config.out_file);
+		process_without_taxonomy(config.fasta_db, config.out_file, config.filter_low_complexity);
 
     return 0;
 }
@@ -28,9 +28,14 @@
 #define DBS_H_INCLUDED
 
 #include "io.h"
+#include "log.h"
+#include "mapped_file.h"
 #include <string>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <cstddef>
+#include <stdint.h>
 
 struct DBS
 {
@@ -50,9 +55,48 @@ struct DBS
 	typedef std::vector<KmerTax> Kmers;
 };
 
+// sorted kmers, either loaded into memory or mapped directly from the file
+template <class C>
+struct DBSArray
+{
+	DBSArray() : first(nullptr), count(0) {}
+
+	const C *begin() const { return first; }
+	const C *end() const { return first + count; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	const C &operator[] (size_t i) const { return first[i]; }
+
+	void assign(std::vector<C> &&v)
+	{
+		mapped.reset();
+		storage = std::move(v);
+		first = storage.data();
+		count = storage.size();
+	}
+
+	void assign(std::unique_ptr<MappedFile> &&file, size_t offset, size_t size)
+	{
+		storage.clear();
+		storage.shrink_to_fit();
+		mapped = std::move(file);
+		first = (const C*)(mapped->data() + offset);
+		count = size;
+	}
+
+private:
+	std::vector<C> storage;
+	std::unique_ptr<MappedFile> mapped;
+	const C *first;
+	size_t count;
+};
+
 struct DBSIO
 {
-	static const int VERSION = 1;
+	static const int VERSION = 1; // header followed by size prefixed vector
+	static const int MAPPED_VERSION = 2; // aligned header with checksum, kmers can be used in place
+	static const size_t MAPPED_MAGIC = 0x5350414d53424400ull; // "\0DBSMAPS"
+	static const size_t DATA_ALIGNMENT = 4096;
 
 	struct DBSHeader
 	{
@@ -60,33 +104,139 @@ struct DBSIO
 		DBSHeader(size_t kmer_len = 0) : version(VERSION), kmer_len(kmer_len){}
 	};
 
+	struct DBSMappedHeader
+	{
+		size_t version, kmer_len; // same as DBSHeader
+		size_t magic, element_size, count, data_offset, reserved, checksum;
+
+		DBSMappedHeader(size_t kmer_len = 0, size_t element_size = 0, size_t count = 0) :
+			version(MAPPED_VERSION), kmer_len(kmer_len), magic(MAPPED_MAGIC), element_size(element_size), count(count), data_offset(DATA_ALIGNMENT), reserved(0)
+		{
+			checksum = MappedHeader::checksum(*this);
+		}
+	};
+
+	// where kmers are in the file
+	struct DBSLayout
+	{
+		size_t version, kmer_len, count, data_offset;
+	};
+
 	template <class C>
 	static void save_dbs(const std::string &out_file, const std::vector<C> &kmers, size_t kmer_len)
 	{
-		std::ofstream f(out_file);
-		DBSHeader header(kmer_len);
-        IO::write(f, header);
-        IO::save_vector(f, kmers);
+		save_dbs(out_file, kmers.data(), kmers.size(), kmer_len);
 	}
 
 	template <class C>
-	static size_t load_dbs(const std::string &filename, std::vector<C> &kmers)
+	static void save_dbs(const std::string &out_file, const C *kmers, size_t count, size_t kmer_len)
 	{
-    	std::ifstream f(filename, std::ios::binary | std::ios::in);
-	    if (f.fail() || f.eof())
-		    throw std::runtime_error(std::string("cannot load dbs ") + filename);
+		std::ofstream f(out_file, std::ios::binary | std::ios::out);
+		save_header(f, kmer_len, sizeof(C), count);
+		f.write((const char*)kmers, sizeof(C) * count);
 
-        DBSHeader header;
-        IO::read(f, header);
-		if (header.version != VERSION)
-			throw std::runtime_error("unsupported dbs file version");
+		if (!f)
+			throw std::runtime_error(std::string("cannot save dbs ") + out_file);
+	}
 
-        IO::load_vector(f, kmers);
+	// writes version 2 header and padding up to the first kmer, f should be at the start of the file
+	static void save_header(std::ofstream &f, size_t kmer_len, size_t element_size, size_t count)
+	{
+		DBSMappedHeader header(kmer_len, element_size, count);
+		IO::write(f, header);
+		std::vector<char> padding(header.data_offset - sizeof(header));
+		IO::save_vector_data(f, padding);
+	}
 
-		if (header.kmer_len < 1 || header.kmer_len > 64)
+	// reads and checks header of any supported version, leaves f at the first kmer
+	static DBSLayout load_layout(std::ifstream &f, size_t element_size)
+	{
+		DBSLayout layout;
+		DBSHeader header;
+		IO::read(f, header);
+		layout.version = header.version;
+		layout.kmer_len = header.kmer_len;
+
+		if (header.version == VERSION)
+		{
+			IO::read(f, layout.count);
+			layout.data_offset = sizeof(DBSHeader) + sizeof(size_t);
+		}
+		else if (header.version == MAPPED_VERSION)
+		{
+			f.seekg(0);
+			DBSMappedHeader mapped_header;
+			IO::read(f, mapped_header);
+			check_header(mapped_header, element_size);
+			layout.count = mapped_header.count;
+			layout.data_offset = mapped_header.data_offset;
+			f.seekg(layout.data_offset);
+		}
+		else
+			throw std::runtime_error("unsupported dbs file version");
+
+		if (layout.kmer_len < 1 || layout.kmer_len > 64)
 			throw std::runtime_error("load_dbs:: invalid kmer_len");
 
-		return header.kmer_len;
+		return layout;
+	}
+
+	template <class C>
+	static size_t load_dbs(const std::string &filename, std::vector<C> &kmers)
+	{
+		std::ifstream f(filename, std::ios::binary | std::ios::in);
+		if (f.fail() || f.eof())
+			throw std::runtime_error(std::string("cannot load dbs ") + filename);
+
+		auto layout = load_layout(f, sizeof(C));
+		IO::load_vector_data(f, kmers, layout.count);
+		return layout.kmer_len;
+	}
+
+	// version 2 files are memory mapped, older ones are loaded
+	template <class C>
+	static size_t load_dbs(const std::string &filename, DBSArray<C> &kmers)
+	{
+		DBSLayout layout;
+		{
+			std::ifstream f(filename, std::ios::binary | std::ios::in);
+			if (f.fail() || f.eof())
+				throw std::runtime_error(std::string("cannot load dbs ") + filename);
+
+			layout = load_layout(f, sizeof(C));
+		}
+
+		if (layout.version != MAPPED_VERSION)
+		{
+			LOG("old dbs version " << layout.version << ", loading to memory");
+			std::vector<C> v;
+			load_dbs(filename, v);
+			kmers.assign(std::move(v));
+			return layout.kmer_len;
+		}
+
+		std::unique_ptr<MappedFile> file(new MappedFile(filename));
+		if (file->size() < layout.data_offset + layout.count * sizeof(C))
+			throw std::runtime_error(std::string("dbs file is truncated ") + filename);
+
+		kmers.assign(std::move(file), layout.data_offset, layout.count);
+		return layout.kmer_len;
+	}
+
+private:
+	static void check_header(const DBSMappedHeader &header, size_t element_size)
+	{
+		if (header.magic != MAPPED_MAGIC)
+			throw std::runtime_error("bad dbs file magic");
+
+		if (header.checksum != MappedHeader::checksum(header))
+			throw std::runtime_error("dbs header checksum mismatch");
+
+		if (header.element_size != element_size)
+			throw std::runtime_error("dbs element size mismatch");
+
+		if (header.data_offset < sizeof(DBSMappedHeader) || header.data_offset % DATA_ALIGNMENT != 0)
+			throw std::runtime_error("bad dbs data offset");
 	}
 };
 
@@ -1,18 +1,19 @@
 #include <string>
 #include <fstream>
 #include <vector>
-#include <list>
+#include <sstream>
 #include <stdexcept>
 #include <iostream>
 #include <chrono>
-#include "omp_adapter.h"
+#include "omp_adapter.h"
 
 typedef uint64_t hash_t;
 
 #include "log.h"
 #include "dbs.h"
+#include "kmer_search.h"
 //#include "aligns_to_dbs_job.h"
-#include "fasta.h"
+#include "fasta_reader.h"
 #include "hash.h"
 #include "config_fasta_contamination.h"
 #include "seq_transform.h"
@@ -31,18 +32,11 @@ struct KmerTax : public DBS::KmerTax
 using namespace std;
 using namespace std::chrono;
 
-const string VERSION = "0.10";
+const string VERSION = "0.12";
 
 typedef int tax_t;
-typedef vector<KmerTax> HashSortedArray;
-
-tax_t find_hash(hash_t hash, tax_t default_value, HashSortedArray &hash_array)
-{
-    auto first = hash_array.begin();
-    auto last = hash_array.end();
-    first = std::lower_bound(first, last, KmerTax(hash, 0));
-    return ((first == last) || (hash < first->kmer) ) ? default_value : first->tax_id;
-}
+typedef DBSArray<KmerTax> HashSortedArray;
+typedef KmerSearch<KmerTax, hash_t> Search;
 
 struct Hit
 {
@@ -51,84 +45,64 @@ struct Hit
     Hit(int pos, tax_t tax_id) : pos(pos), tax_id(tax_id){}
 };
 
-typedef std::list<Hit> Hits;
-
-struct SeqContamination
-{
-    string desc;
-    Hits hits;
-    SeqContamination(const string &desc, const Hits &hits) : desc(desc), hits(hits){}
-};
-
-typedef std::list<SeqContamination> SeqContaminations;
+typedef std::vector<Hit> Hits;
 
+// hits of one file, sequences are formatted as soon as they are checked
 struct Contamination
 {
     string filename;
-    SeqContaminations seqs;
-    int total_hits;
-
-    Contamination(const string &filename) : filename(filename), total_hits(0){}
+    size_t seq_count;
+    size_t total_hits;
+    std::ostringstream seqs;
 
-    bool operator <(const Contamination &x) const
-    {
-        return total_hits > x.total_hits;
-    }
+    Contamination(const string &filename) : filename(filename), seq_count(0), total_hits(0){}
 
-    void add(const SeqContamination &seq)
+    void add(const p_string &desc, const Hits &hits)
     {
-        seqs.push_back(seq);
-        total_hits += seq.hits.size();
+        seq_count++;
+        total_hits += hits.size();
+        seqs << desc << '\n' << hits.size() << '\n';
+        for (auto &h : hits)
+            seqs << h.pos << '\t' << h.tax_id << '\n';
     }
 };
 
-Contamination check_for_contamination(const string &filename, int kmer_len, HashSortedArray &hash_array)
+void check_for_contamination(Contamination &result, const Search &search)
 {
-    Fasta fasta(filename);
-    
-    Contamination result(filename);
+    FastaReader fasta(result.filename);
+    Reader::Chunk chunk; // kmers are taken right from the chunk buffer, which is reused from sequence to sequence
+    Hits hits;
 
-    string seq;
-    while (fasta.get_next_sequence(seq))
+    while (fasta.read_chunk(chunk, 1)) // one sequence at a time, genomes can be long
     {
-        string desc = fasta.sequence_description();
-        Hits hits;
+        auto seq = chunk.bases(0);
+        hits.clear();
 
-        int pos = 0;
-        Hash<hash_t>::for_all_hashes_do(seq, kmer_len, [&](hash_t hash)
+        search.find_all_kmers_at(seq.s, seq.len, [&](const KmerTax *found, hash_t, int pos)
         {
-			hash = seq_transform<hash_t>::min_hash_variant(hash, kmer_len);
-            auto tax_id = find_hash(hash, 0, hash_array);
-            if (tax_id)
-                hits.push_back(Hit(pos, tax_id));
+            if (found && found->tax_id)
+                hits.push_back(Hit(pos, found->tax_id));
 
-            pos++;
             return true;
         });
 
         if (!hits.empty())
-            result.add(SeqContamination(desc, hits));
-    }    
-
-    return result;
+            result.add(chunk.spotid(0), hits);
+    }
 }
 
 void print(const Contamination &r)
 {
-    cout << r.filename << endl;
-    cout << r.seqs.size() << endl;
-    for (auto &s : r.seqs)
-    {
-        cout << s.desc << endl;
-        cout << s.hits.size() << endl;
-        for (auto &h : s.hits)
-            cout << h.pos << '\t' << h.tax_id << endl;
-    }
+    cout << r.filename << '\n';
+    cout << r.seq_count << '\n';
+    cout << r.seqs.str() << flush;
 }
 
 int main(int argc, char const *argv[])
 {
 	Config config(argc, argv);
+	LOG("fasta_contamination version " << VERSION);
+	LOG("files with hits are printed as soon as they are checked, in completion order, not sorted by hit count");
 
 	auto before = high_resolution_clock::now();
 
@@ -136,32 +110,25 @@ int main(int argc, char const *argv[])
 
 	HashSortedArray hash_array;
 	int kmer_len = DBSIO::load_dbs(config.dbs, hash_array);
+    Search search(hash_array.begin(), hash_array.size(), kmer_len); // shared by all threads
 
     const int THREADS = 48;
-    list<Contamination> contaminations; // todo: list ?
 
-	#pragma omp parallel num_threads(THREADS) 
-	for (int i = omp_get_thread_num(); i < file_list.files.size(); i += omp_get_num_threads())
+    // files are printed as they finish, so only files being checked are kept in memory
+	#pragma omp parallel for schedule(dynamic, 1) num_threads(THREADS)
+	for (int i = 0; i < int(file_list.files.size()); i++)
 	{
-        auto file_list_element = file_list.files[i];
-		auto contamination = check_for_contamination(file_list_element.filename, kmer_len, hash_array);
+        auto &file_list_element = file_list.files[i];
+        Contamination contamination(file_list_element.filename);
+		check_for_contamination(contamination, search);
 
         #pragma omp critical (read)
         {
 		    LOG(contamination.total_hits << "\thits\t" << file_list_element.filename);
             if (contamination.total_hits > 0)
-                contaminations.push_back(contamination);
-//            if (contamination.total_hits > 0)
-//                print(contamination);
+                print(contamination);
         }
 	}
 
-//    std::sort(contaminations.begin(), contaminations.end());
-//    cout << "sorted:" << endl;
-    contaminations.sort();
-
-    for (auto &r : contaminations)
-        print(r);
-
 	LOG("total time (min) " << std::chrono::duration_cast<std::chrono::minutes>( high_resolution_clock::now() - before ).count());
 }
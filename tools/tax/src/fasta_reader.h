@@ -32,13 +32,16 @@
 #include <assert.h>
 
 #include "reader.h"
+#include "input_streambuf.h"
 
 class FastaReader final: public Reader {
 private:
-    mutable std::ifstream f;
+    InputStreambuf buf;
+    mutable std::istream f;
     size_t fsize;
     size_t spot_idx;
     std::string last_desc;
+    std::string chunk_line;
 
     static bool is_description(const std::string &s)
 	{
@@ -63,16 +66,18 @@ private:
 public:
 
     static bool is_fasta(const std::string &filename) {
-        return ends_with(filename, ".fasta") || ends_with(filename, ".fa") || ends_with(filename, ".fna");
+        const auto name = InputStreambuf::without_gz(filename);
+        return ends_with(name, ".fasta") || ends_with(name, ".fa") || ends_with(name, ".fna");
     }
     
-	FastaReader(const std::string &filename)
-        : f(filename, std::ios::binary)
+	// thread_count - for inflating bgzf input, see InputStreambuf
+	FastaReader(const std::string &filename, int thread_count = -1)
+        : buf(filename, thread_count)
+        , f(&buf)
         , spot_idx(0)
 	{
-        f.seekg(0, std::ios::end);
-        fsize = f.tellg();
-        f.seekg(0, std::ios::beg);
+        f.exceptions(std::ios::badbit); // decoding errors come from buf as exceptions
+        fsize = buf.file_size();
         
         std::string line;
         read_line(line);
@@ -95,7 +100,7 @@ public:
     
     virtual float progress() const override {
         if (!f.eof()) {
-            return float(f.tellg()) / fsize;
+            return fsize ? float(buf.file_pos()) / fsize : 1;
         } else {
             return 1;
         }
@@ -133,5 +138,29 @@ public:
         ++spot_idx;
         return true;
     }
+
+    // bases go straight into chunk buffer, no allocations per fragment
+    bool read_chunk(Chunk& chunk, size_t max_count) override {
+        chunk.clear();
+        while (chunk.size() < max_count && !f.eof()) {
+            chunk.start(last_desc.data() + 1, last_desc.size() - 1);
+            while (!f.eof()) {
+                read_line(chunk_line);
+
+                if (is_description(chunk_line)) {
+                    last_desc = chunk_line;
+                    break;
+                } else {
+                    chunk.append_bases(chunk_line.data(), chunk_line.size());
+                }
+            }
+
+            if (chunk.entries.back().bases_len == 0) {
+                throw std::runtime_error("Read is empty");
+            }
+            ++spot_idx;
+        }
+        return !chunk.empty();
+    }
 };
 
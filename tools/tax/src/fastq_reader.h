@@ -0,0 +1,149 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#pragma once
+
+#include <string>
+#include <istream>
+#include <assert.h>
+
+#include "reader.h"
+#include "input_streambuf.h"
+
+// four lines per read: @spotid, bases, +, qualities
+class FastqReader final: public Reader {
+private:
+    InputStreambuf buf;
+    mutable std::istream f;
+    size_t fsize;
+    size_t spot_idx;
+    const bool read_qualities;
+    std::string header, bases, plus, qualities; // of the last read, reused
+
+    void read_line(std::string& line) {
+        std::getline(f, line);
+        // handling windows line endings
+        if (!line.empty() && *line.rbegin() == '\r') {
+            line.erase(line.size() - 1);
+        }
+    }
+
+    static bool ends_with(const std::string &s, const std::string &end) {
+        if (end.size() > s.size())
+            return false;
+
+        return std::equal(end.rbegin(), end.rend(), s.rbegin());
+    }
+
+    bool next_read() {
+        do {
+            if (f.eof()) {
+                return false;
+            }
+            read_line(header);
+        } while (header.empty());
+
+        read_line(bases);
+        read_line(plus);
+        read_line(qualities);
+        if (header[0] != '@' || plus.empty() || plus[0] != '+') {
+            throw std::runtime_error("invalid fastq read at " + header);
+        }
+        if (bases.empty()) {
+            throw std::runtime_error("Read is empty");
+        }
+        if (qualities.size() != bases.size()) {
+            throw std::runtime_error("fastq qualities do not match bases at " + header);
+        }
+        if (read_qualities) {
+            for (size_t i = 0; i < bases.size(); ++i) {
+                static const int SAM_QUALITY_BASE = 33;
+                static const int MIN_GOOD_QUALITY = SAM_QUALITY_BASE + 3;
+                if ((unsigned char)qualities[i] < MIN_GOOD_QUALITY) {
+                    bases[i] = '!'; // like vdb reader does
+                }
+            }
+        }
+        ++spot_idx;
+        return true;
+    }
+
+public:
+    static bool is_fastq(const std::string &filename) {
+        const auto name = InputStreambuf::without_gz(filename);
+        return ends_with(name, ".fastq") || ends_with(name, ".fq");
+    }
+
+    // thread_count - for inflating bgzf input, see InputStreambuf
+    FastqReader(const std::string &filename, bool read_qualities = false, int thread_count = -1)
+        : buf(filename, thread_count)
+        , f(&buf)
+        , spot_idx(0)
+        , read_qualities(read_qualities)
+    {
+        f.exceptions(std::ios::badbit); // decoding errors come from buf as exceptions
+        fsize = buf.file_size();
+        const auto first = f.peek();
+        if (first == std::istream::traits_type::eof())
+            throw std::runtime_error("fastq file is empty");
+
+        if (first != '@')
+            throw std::runtime_error("this is not a fastq file");
+    }
+
+    SourceStats stats() const override {
+        assert(f.eof());
+        return SourceStats(spot_idx);
+    }
+
+    float progress() const override {
+        if (!f.eof()) {
+            return fsize ? float(buf.file_pos()) / fsize : 1;
+        } else {
+            return 1;
+        }
+    }
+
+    bool read(Fragment* output) override {
+        if (!next_read()) {
+            return false;
+        }
+        if (output) {
+            output->spotid.assign(header, 1, header.size() - 1);
+            output->bases = bases;
+        }
+        return true;
+    }
+
+    bool read_chunk(Chunk& chunk, size_t max_count) override {
+        chunk.clear();
+        while (chunk.size() < max_count && next_read()) {
+            chunk.start(header.data() + 1, header.size() - 1);
+            chunk.append_bases(bases.data(), bases.size());
+        }
+        return !chunk.empty();
+    }
+};
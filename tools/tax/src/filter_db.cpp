@@ -30,6 +30,7 @@
 
 #include "log.h"
 #include "config_filter_db.h"
+#include "low_complexity.h"
 
 using namespace std;
 
@@ -50,19 +51,6 @@ void pass(const string &kmer)
 	cout << kmer << endl;
 }
 
-int predicted(const string &kmer)
-{
-	int pred = 0;
-
-	for (int i = 4; i<int(kmer.length()); i++)
-		if (kmer[i] == kmer[i - 1] && kmer[i - 1] == kmer[i - 2] && kmer[i - 2] == kmer[i - 3] && kmer[i - 3] == kmer[i - 4])
-			pred++;
-		else if (i >= 8 && kmer[i] == kmer[i - 2] && kmer[i - 2] == kmer[i - 4] && kmer[i - 4] == kmer[i - 6] && kmer[i - 6] == kmer[i - 8])
-			pred++;
-
-	return pred;
-}
-
 bool bad_tax(unsigned int tax_id, unsigned int config_only_tax_id)
 {
 	const int CELLULAR_ORGANISMS = 131567;
@@ -101,9 +89,8 @@ int main(int argc, char const *argv[])
 			continue;
 		}
 
-		auto score = predicted(kmer);
-		const int MIN_SCORE = 13 * kmer.length()/32; // const 13 was designed for 32 bp kmers
-		if (score >= MIN_SCORE)
+		auto score = LowComplexity::predicted(kmer);
+		if (score >= LowComplexity::min_score(int(kmer.length())))
 			dont_pass(kmer, tax_id);
 		else
 			if (config.only_tax)
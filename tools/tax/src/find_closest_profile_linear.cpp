@@ -9,6 +9,10 @@
 
 typedef uint64_t hash_t;
 
+#include "profile_index.h"
+#include "profile_store.h"
+#include "profile_similarity.h"
+
 using namespace std;
 using namespace std::chrono;
 
@@ -18,8 +22,6 @@ struct Profile
     vector<hash_t> kmers;
 };
 
-typedef std::vector<Profile> Profiles;
-
 void load_profile(const string &filename, Profile &profile)
 {
     std::ifstream f(filename, std::ios::in | std::ios::binary);
@@ -30,75 +32,139 @@ void load_profile(const string &filename, Profile &profile)
     IO::load_vector(f, profile.kmers);
 }
 
-void load_profiles(const string &file_list_name, Profiles &profiles)
+void load_profiles(const string &file_list_name, ProfileStore &profiles)
 {
 	FileListLoader file_list(file_list_name);
-    profiles.resize(file_list.files.size());
     cout << "loading " << file_list.files.size() << " profiles" << endl;
+    Profile profile;
     for (int file_number = 0; file_number < int(file_list.files.size()); file_number ++)
     {
         auto &file = file_list.files[file_number];
-        load_profile(file.filename, profiles[file_number]);
-//        load_profile(file.filename + ".profile", profiles[file_number]);
+        load_profile(file.filename, profile);
+//        load_profile(file.filename + ".profile", profile);
+        profiles.add(profile.filename, profile.kmers);
     }
     cout << "loaded" << endl;
 }
 
-struct ProfileSimilarity
+struct ComparisonResult
 {
-    double operator() ( const Profile &a, const Profile &b) const
-    {
-        if (a.kmers.size() != b.kmers.size())
-            throw std::runtime_error("ProfileSimilarity:: a.kmers.size() != b.kmers.size()");
-
-        if (a.kmers.empty())
-            throw std::runtime_error("ProfileSimilarity:: a.kmers.empty()");
+    double sim = 0;
+    string filename;
 
-        double sum = 0;
-        for (int i=0; i < a.kmers.size(); i++)
-            if (a.kmers[i] == b.kmers[i])
-                sum++;
+    ComparisonResult() = default;
+    ComparisonResult(double sim, const string &filename) : sim(sim), filename(filename){}
 
-        return sum / a.kmers.size();
+    bool operator < (const ComparisonResult &x) const
+    {
+        return sim > x.sim;
     }
 };
 
-int main(int argc, char const *argv[])
+typedef std::vector<ComparisonResult> ComparisonResults;
+
+const int THREADS = 32;
+
+ComparisonResults compare(const Profile &profile, const ProfileStore &profiles)
 {
-	Config config(argc, argv);
+    if (profiles.size() > 0 && profiles.profile_len() != profile.kmers.size())
+        throw std::runtime_error("ProfileSimilarity:: a.kmers.size() != b.kmers.size()");
 
-	auto before = high_resolution_clock::now();
+    ProfileSimilarity sim;
+    ComparisonResults res(profiles.size());
+
+   	#pragma omp parallel for num_threads(THREADS)
+    for (int i = 0; i < res.size(); i++)
+        res[i] = ComparisonResult(sim(profile.kmers.data(), profiles.kmers(i), profile.kmers.size()), profiles.name(i));
 
-    Profiles profiles;
+    return res;
+}
+
+ComparisonResults compare_linear(const Config &config, const Profile &profile)
+{
+    if (ProfileStore::is_store(config.file_list))
+        return compare(profile, ProfileStore(config.file_list));
+
+    ProfileStore profiles;
     load_profiles(config.file_list, profiles);
+    return compare(profile, profiles);
+}
 
-    Profile profile;
-    load_profile(config.profile_file, profile);
+// only profiles sharing a band with the query are loaded and compared
+ComparisonResults compare_indexed(const Config &config, const Profile &profile)
+{
+    std::unique_ptr<ProfileStore> store;
+    vector<string> filenames;
+    if (ProfileStore::is_store(config.file_list))
+    {
+        store.reset(new ProfileStore(config.file_list));
+        filenames = store->filenames();
+    }
+    else
+    {
+        FileListLoader file_list(config.file_list);
+        for (auto &file : file_list.files)
+            filenames.push_back(file.filename);
+    }
 
-    ProfileSimilarity sim;
+    auto source_hash = ProfileIndex::source_hash(filenames, store ? vector<string>(1, config.file_list) : filenames);
+    if (!ProfileIndex::is_current(config.index_file, filenames.size(), source_hash))
+    {
+        cout << "building index of " << filenames.size() << " profiles" << endl;
+        ProfileIndex::build(config.index_file, filenames.size(), profile.kmers.size(), source_hash, [&](size_t i, vector<hash_t> &kmers)
+        {
+            if (store)
+                kmers.assign(store->kmers(i), store->kmers(i) + store->profile_len());
+            else
+            {
+                Profile indexed;
+                load_profile(filenames[i], indexed);
+                kmers.swap(indexed.kmers);
+            }
+        });
+    }
 
-    struct ComparisonResult
+    ProfileIndex index(config.index_file);
+    if (!index.matches(filenames.size(), source_hash))
+        throw std::runtime_error(string("profile index is built for another file list ") + config.index_file);
+
+    auto candidates = index.candidates(profile.kmers);
+    cout << candidates.size() << " candidates of " << filenames.size() << " profiles" << endl;
+
+    ProfileStore profiles;
+    Profile candidate;
+    for (auto i : candidates)
     {
-        double sim = 0;
-        string filename;
+        if (store)
+            candidate.kmers.assign(store->kmers(i), store->kmers(i) + store->profile_len());
+        else
+            load_profile(filenames[i], candidate);
 
-        ComparisonResult() = default;
-        ComparisonResult(double sim, const string &filename) : sim(sim), filename(filename){}
+        profiles.add(filenames[i], candidate.kmers);
+    }
 
-        bool operator < (const ComparisonResult &x) const
-        {
-            return sim > x.sim;
-        }
-    };
+    return compare(profile, profiles);
+}
 
-    typedef std::vector<ComparisonResult> ComparisonResults;
+int main(int argc, char const *argv[])
+{
+	Config config(argc, argv);
 
-    ComparisonResults res(profiles.size());
+	auto before = high_resolution_clock::now();
 
-    const int THREADS = 32;
-   	#pragma omp parallel for num_threads(THREADS)
-    for (int i = 0; i < res.size(); i++)
-        res[i] = ComparisonResult(sim(profile, profiles[i]), profiles[i].filename);
+    if (!config.store_file.empty())
+    {
+        ProfileStore profiles;
+        load_profiles(config.file_list, profiles);
+        profiles.save(config.store_file);
+        cout << "saved " << profiles.size() << " profiles to " << config.store_file << endl;
+        return 0;
+    }
+
+    Profile profile;
+    load_profile(config.profile_file, profile);
+
+    auto res = config.index_file.empty() ? compare_linear(config, profile) : compare_indexed(config, profile);
 
     std::sort(res.begin(), res.end());
 
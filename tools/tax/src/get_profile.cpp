@@ -12,6 +12,7 @@ typedef uint64_t hash_t;
 
 #include "hash.h"
 #include "fasta.h"
+#include "min_hash.h"
 
 #include "omp_adapter.h"
 
@@ -20,115 +21,6 @@ using namespace std::chrono;
 
 #define DO_PARALLEL_PER_FILE 0
 
-struct MinHash
-{
-    struct Best
-    {
-        uint64_t hash = UINT64_MAX;
-        hash_t kmer = 0;
-        Best() = default;
-        Best(uint64_t hash, hash_t kmer) : hash(hash), kmer(kmer){}
-    };
-
-    vector<Best> best; //, storage;
-    vector<uint64_t> storage_hash; // memory fetch optimization
-    vector<hash_t> storage_kmer;
-
-    vector<uint64_t> xors;
-
-    MinHash(size_t count) : best(count), xors(count)
-    {
-        std::mt19937 rng;
-        rng.seed(0);
-        std::uniform_int_distribution<std::mt19937::result_type> dist(0, UINT32_MAX);
-        for (int i = 0; i < count; i++)
-            xors[i] = (uint64_t(dist(rng)) << 32) | dist(rng);
-
-        storage_hash.reserve(10000000); // todo: think. filesize ?
-        storage_kmer.reserve(10000000); // todo: think. filesize ?
-    }
-
-    void add(uint64_t hash, hash_t kmer)
-    {
-        storage_hash.push_back(hash);
-        storage_kmer.push_back(kmer);
-    }
-
-    void finish()
-    {
-#if !DO_PARALLEL_PER_FILE
-        #pragma omp parallel for
-#endif
-        for (int ib = 0; ib < best.size(); ib ++)
-        {
-            auto _xor = xors[ib];
-
-            const int BUCKETS = 4;
-            vector<Best> best_chosen;
-            for (int i = 0; i < BUCKETS; i++)
-                best_chosen.push_back(best[ib]);
-
-            auto storage_limit = (storage_hash.size() / BUCKETS) * BUCKETS;
-            for (size_t to_check_i = 0; to_check_i < storage_limit; to_check_i += BUCKETS)
-            {
-#if 0
-                union
-                {
-                    __uint128_t h128;
-                    struct
-                    {
-                        hash_t h0, h1;
-                    } h64;
-                } h01, h23;
-
-                h01.h128 = *(__uint128_t*)&storage_hash[to_check_i + 0];
-                h23.h128 = *(__uint128_t*)&storage_hash[to_check_i + 2];
-//                h.h128 ^= _xor128; - slower
-                hash_t h0 = h01.h64.h0 ^ _xor;
-                hash_t h1 = h01.h64.h1 ^ _xor;
-                hash_t h2 = h23.h64.h0 ^ _xor;
-                hash_t h3 = h23.h64.h1 ^ _xor;
-#else
-                const auto to_check0 = storage_hash[to_check_i + 0];
-                const auto to_check1 = storage_hash[to_check_i + 1];
-                const auto to_check2 = storage_hash[to_check_i + 2];
-                const auto to_check3 = storage_hash[to_check_i + 3];
-
-                hash_t h0 = to_check0 ^ _xor;
-                hash_t h1 = to_check1 ^ _xor;
-                hash_t h2 = to_check2 ^ _xor;
-                hash_t h3 = to_check3 ^ _xor;
-#endif
-
-                if (h0 < best_chosen[0].hash)
-                    best_chosen[0] = Best(h0, storage_kmer[to_check_i + 0]);
-                if (h1 < best_chosen[1].hash)
-                    best_chosen[1] = Best(h1, storage_kmer[to_check_i + 1]);
-                if (h2 < best_chosen[2].hash)
-                    best_chosen[2] = Best(h2, storage_kmer[to_check_i + 2]);
-                if (h3 < best_chosen[3].hash)
-                    best_chosen[3] = Best(h3, storage_kmer[to_check_i + 3]);
-            }
-
-
-            for (size_t to_check_i = storage_limit; to_check_i < storage_hash.size(); to_check_i ++)
-            {
-                hash_t h0 = storage_hash[to_check_i + 0] ^ _xor;
-
-                if (h0 < best_chosen[0].hash)
-                    best_chosen[0] = Best(h0, storage_kmer[to_check_i + 0]);
-            }
-
-            for (int i = 0; i < BUCKETS; i++)
-                if (best_chosen[i].hash < best[ib].hash)
-                    best[ib] = best_chosen[i];
-        }
-
-        storage_hash.clear();
-        storage_kmer.clear();
-    }
-};
-
 uint64_t fnv1_hash (void *key, int n_bytes)
 {
     unsigned char *p = (unsigned char *)key;
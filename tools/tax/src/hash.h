@@ -28,6 +28,69 @@
 #define HASH_H_INCLUDED
 
 #include <algorithm>
+#include <string>
+
+// forward and reverse complement hashes of the last kmer_len letters, rolled in O(1) per letter
+// any letter other than ACGT starts the kmer over
+template <class hash_t>
+class RollingKmer
+{
+	int kmer_len;
+	int letters;
+	hash_t mask;
+	hash_t forward_hash, reverse_hash;
+
+public:
+	RollingKmer(int kmer_len) : 
+		kmer_len(kmer_len), 
+		letters(0),
+		mask(kmer_len * 2 >= int(sizeof(hash_t) * 8) ? ~hash_t(0) : (hash_t(1) << (kmer_len * 2)) - 1),
+		forward_hash(0),
+		reverse_hash(0)
+	{}
+
+	// returns true when the last kmer_len letters make a valid kmer
+	bool add(char ch)
+	{
+		int code = letter_code(ch);
+		if (code < 0)
+		{
+			reset();
+			return false;
+		}
+
+		forward_hash = ((forward_hash << 2) | hash_t(code)) & mask;
+		reverse_hash = (reverse_hash >> 2) | (hash_t(code ^ 2) << (kmer_len * 2 - 2));
+		if (letters < kmer_len)
+			letters++;
+
+		return letters == kmer_len;
+	}
+
+	void reset()
+	{
+		letters = 0;
+		forward_hash = reverse_hash = 0;
+	}
+
+	hash_t forward() const { return forward_hash; }
+	hash_t reverse_complement() const { return reverse_hash; }
+	hash_t canonical() const { return std::min(forward_hash, reverse_hash); }
+
+	// same codes as Hash::update_hash: A 0, C 1, T 2, G 3
+	static int letter_code(char ch)
+	{
+		switch (ch)
+		{
+			case 'A': case 'a': return 0;
+			case 'C': case 'c': return 1;
+			case 'T': case 't': return 2;
+			case 'G': case 'g': return 3;
+		};
+
+		return -1;
+	}
+};
 
 template <class hash_t>
 struct Hash
@@ -138,14 +201,36 @@ struct Hash
 	template <class Lambda>
 	static void for_all_hashes_do(const std::string &s, int kmer_len, Lambda &&lambda)
 	{
-		if (s.length() < kmer_len)
+		for_all_hashes_do(s.data(), int(s.length()), kmer_len, lambda);
+	}
+
+	// reads no further than s + len, so that s can point into a bigger buffer
+	template <class Lambda>
+	static void for_all_hashes_do(const char *s, int len, int kmer_len, Lambda &&lambda)
+	{
+		if (len < kmer_len)
 			return;
 
-		auto hash = hash_of(&s[0], kmer_len);
-		for (int i=0; i <= s.size() - kmer_len; i++, hash = hash_next(&s[i], hash, kmer_len))
-			if (!lambda(hash))
+		auto hash = hash_of(s, kmer_len);
+		for (int i=0; lambda(hash) && i < len - kmer_len; )
+			hash = hash_next(&s[++i], hash, kmer_len);
+	}
+
+	// lambda(hash, pos) gets canonical hash of every kmer without non ACGT letters, pos is where the kmer starts
+	template <class Lambda>
+	static void for_all_canonical_hashes_do(const char *s, int len, int kmer_len, Lambda &&lambda)
+	{
+		RollingKmer<hash_t> kmer(kmer_len);
+		for (int i=0; i < len; i++)
+			if (kmer.add(s[i]) && !lambda(kmer.canonical(), i - kmer_len + 1))
 				break;
 	}
+
+	template <class Lambda>
+	static void for_all_canonical_hashes_do(const std::string &s, int kmer_len, Lambda &&lambda)
+	{
+		for_all_canonical_hashes_do(s.data(), int(s.length()), kmer_len, lambda);
+	}
 };
 
 #if defined ( __GNUC__ ) && __GNUC__ <= 4
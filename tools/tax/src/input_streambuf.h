@@ -0,0 +1,394 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <streambuf>
+#include <stdexcept>
+#include <exception>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <stdint.h>
+#include <zlib.h>
+
+// plain, gzip or bgzf file as a stream, format is detected by content
+// bgzf blocks are independent, so they are inflated by several threads ahead of the reader
+// thread_count: negative means auto, 0 or 1 - blocks are inflated by the reading thread itself
+class InputStreambuf final: public std::streambuf {
+public:
+    static const size_t BUFFER_SIZE = 1 << 20;
+    static const size_t BLOCKS_PER_BATCH = 64; // bgzf block is up to 64K
+
+    explicit InputStreambuf(const std::string& filename, int thread_count = -1)
+        : f(filename, std::ios::binary)
+        , fsize(0)
+        , fpos(0)
+        , format(PLAIN)
+        , z_initialized(false)
+        , z_member_done(false)
+        , stopping(false)
+        , all_read(false)
+        , max_pending(0)
+        , read_pos(0)
+        , next_batch(0)
+        , batch_count(0)
+    {
+        if (f.fail()) {
+            throw std::runtime_error("cannot open file " + filename);
+        }
+        f.seekg(0, std::ios::end);
+        fsize = f.tellg();
+        f.seekg(0, std::ios::beg);
+
+        unsigned char header[18];
+        f.read(reinterpret_cast<char*>(header), sizeof(header));
+        const size_t header_size = f.gcount();
+        f.clear();
+        f.seekg(0, std::ios::beg);
+        if (header_size >= 2 && header[0] == 0x1f && header[1] == 0x8b) {
+            format = (header_size == sizeof(header) && bgzf_block_size(header) > 0) ? BGZF : GZIP;
+        }
+
+        buffer.resize(BUFFER_SIZE);
+        setg(&buffer[0], &buffer[0], &buffer[0]);
+
+        if (format == GZIP) {
+            z = z_stream();
+            if (inflateInit2(&z, 15 + 32) != Z_OK) {
+                throw std::runtime_error("cannot init gzip decoder");
+            }
+            z_initialized = true;
+            compressed.resize(BUFFER_SIZE);
+        } else if (format == BGZF) {
+            if (thread_count < 0) {
+                thread_count = std::max(std::thread::hardware_concurrency() / 2, 1u);
+            }
+            if (thread_count > 1) {
+                max_pending = 2 * thread_count;
+                for (int i = 0; i < thread_count; ++i) {
+                    threads.push_back(std::thread(&InputStreambuf::inflate_batches, this));
+                }
+            }
+        }
+    }
+
+    ~InputStreambuf() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            changed.notify_all();
+        }
+        for (auto& thread: threads) {
+            thread.join();
+        }
+        if (z_initialized) {
+            inflateEnd(&z);
+        }
+    }
+
+    InputStreambuf(const InputStreambuf&) = delete;
+    InputStreambuf& operator=(const InputStreambuf&) = delete;
+
+    size_t file_size() const { return fsize; }
+
+    size_t inflate_thread_count() const { return threads.size(); }
+
+    // bytes of the file already decoded, for progress
+    size_t file_pos() const { return fpos; }
+
+    // file name without .gz, to detect format by extension
+    static std::string without_gz(const std::string& filename) {
+        const std::string gz = ".gz";
+        if (filename.size() > gz.size() && filename.compare(filename.size() - gz.size(), gz.size(), gz) == 0) {
+            return filename.substr(0, filename.size() - gz.size());
+        }
+        return filename;
+    }
+
+protected:
+    int_type underflow() override {
+        if (gptr() < egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+
+        size_t size = 0;
+        switch (format) {
+        case PLAIN:
+            size = read_plain();
+            break;
+        case GZIP:
+            size = read_gzip();
+            break;
+        case BGZF:
+            size = read_bgzf();
+            break;
+        }
+        if (!size) {
+            return traits_type::eof();
+        }
+        setg(&buffer[0], &buffer[0], &buffer[0] + size);
+        return traits_type::to_int_type(*gptr());
+    }
+
+private:
+    enum Format {
+        PLAIN,
+        GZIP,
+        BGZF,
+    };
+
+    struct Batch {
+        std::vector<char> compressed;
+        std::vector<size_t> blocks; // offsets of blocks in compressed, plus end
+        std::vector<char> data;
+        size_t file_end; // file position after the batch
+    };
+
+    std::ifstream f;
+    size_t fsize;
+    size_t fpos;
+    Format format;
+    std::vector<char> buffer;
+
+    // gzip
+    z_stream z;
+    bool z_initialized;
+    bool z_member_done; // to tell truncated file from the end of the last member
+    std::vector<char> compressed;
+
+    // bgzf, batches are numbered in file order, reader takes them in the same order
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool stopping;
+    bool all_read;
+    size_t max_pending;
+    size_t read_pos; // file position of the next block
+    size_t next_batch; // to be taken by reader
+    size_t batch_count; // read from file so far
+    std::map<size_t, Batch> ready;
+    std::exception_ptr error;
+
+    size_t read_plain() {
+        f.read(&buffer[0], buffer.size());
+        const size_t size = f.gcount();
+        fpos += size;
+        return size;
+    }
+
+    size_t read_gzip() {
+        z.next_out = reinterpret_cast<Bytef*>(&buffer[0]);
+        z.avail_out = uInt(buffer.size());
+        while (z.avail_out == buffer.size()) {
+            if (z.avail_in == 0) {
+                f.read(&compressed[0], compressed.size());
+                const size_t size = f.gcount();
+                if (!size) {
+                    if (!z_member_done) {
+                        throw std::runtime_error("truncated gzip file");
+                    }
+                    break;
+                }
+                fpos += size;
+                z.next_in = reinterpret_cast<Bytef*>(&compressed[0]);
+                z.avail_in = uInt(size);
+            }
+
+            const int res = inflate(&z, Z_NO_FLUSH);
+            z_member_done = res == Z_STREAM_END;
+            if (res == Z_STREAM_END) {
+                inflateReset(&z); // next member of concatenated gzip, if any
+            } else if (res != Z_OK && res != Z_BUF_ERROR) {
+                throw std::runtime_error("gzip decoding failed");
+            }
+        }
+        return buffer.size() - z.avail_out;
+    }
+
+    size_t read_bgzf() {
+        if (threads.empty()) {
+            Batch batch;
+            while (read_batch(batch)) {
+                inflate_batch(batch);
+                fpos = batch.file_end;
+                if (!batch.data.empty()) {
+                    std::swap(buffer, batch.data);
+                    return buffer.size();
+                }
+            }
+            return 0;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+            auto it = ready.find(next_batch);
+            if (it != ready.end()) {
+                Batch batch = std::move(it->second);
+                ready.erase(it);
+                ++next_batch;
+                changed.notify_all();
+                fpos = batch.file_end;
+                if (!batch.data.empty()) {
+                    std::swap(buffer, batch.data);
+                    return buffer.size();
+                }
+            } else if (all_read && next_batch == batch_count) {
+                return 0;
+            } else {
+                changed.wait(lock);
+            }
+        }
+    }
+
+    // total size of bgzf block by its header, 0 if it is not bgzf
+    static size_t bgzf_block_size(const unsigned char* header) {
+        // fixed gzip header with FEXTRA and the only BC subfield
+        if (header[0] != 0x1f || header[1] != 0x8b || header[2] != 8 || !(header[3] & 4)) {
+            return 0;
+        }
+        const size_t xlen = header[10] | (header[11] << 8);
+        if (xlen != 6 || header[12] != 'B' || header[13] != 'C' || header[14] != 2 || header[15] != 0) {
+            return 0;
+        }
+        return (header[16] | (header[17] << 8)) + 1;
+    }
+
+    // reads next blocks from the file, under lock
+    bool read_batch(Batch& batch) {
+        batch.compressed.clear();
+        batch.blocks.clear();
+        while (batch.blocks.size() < BLOCKS_PER_BATCH) {
+            unsigned char header[18];
+            f.read(reinterpret_cast<char*>(header), sizeof(header));
+            if (f.gcount() == 0) {
+                break;
+            }
+            const size_t block_size = f.gcount() == sizeof(header) ? bgzf_block_size(header) : 0;
+            if (block_size < sizeof(header) + 8) {
+                throw std::runtime_error("invalid bgzf block");
+            }
+            const size_t offset = batch.compressed.size();
+            batch.blocks.push_back(offset);
+            batch.compressed.resize(offset + block_size);
+            std::copy(header, header + sizeof(header), batch.compressed.begin() + offset);
+            f.read(&batch.compressed[offset + sizeof(header)], block_size - sizeof(header));
+            if (size_t(f.gcount()) != block_size - sizeof(header)) {
+                throw std::runtime_error("truncated bgzf block");
+            }
+            read_pos += block_size;
+        }
+        batch.blocks.push_back(batch.compressed.size());
+        batch.file_end = read_pos;
+        return batch.blocks.size() > 1;
+    }
+
+    static void inflate_batch(Batch& batch) {
+        size_t total = 0;
+        for (size_t i = 0; i + 1 < batch.blocks.size(); ++i) {
+            const char* end = &batch.compressed[0] + batch.blocks[i + 1];
+            total += read_uint32(end - 4);
+        }
+        batch.data.resize(total);
+
+        z_stream block_z = z_stream();
+        if (inflateInit2(&block_z, -15) != Z_OK) {
+            throw std::runtime_error("cannot init bgzf decoder");
+        }
+        size_t data_offset = 0;
+        for (size_t i = 0; i + 1 < batch.blocks.size(); ++i) {
+            const char* block = &batch.compressed[0] + batch.blocks[i];
+            const char* end = &batch.compressed[0] + batch.blocks[i + 1];
+            const size_t size = read_uint32(end - 4);
+            if (size == 0) { // e.g. eof marker
+                continue;
+            }
+            inflateReset(&block_z);
+            block_z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(block + 18));
+            block_z.avail_in = uInt(end - 8 - (block + 18));
+            block_z.next_out = reinterpret_cast<Bytef*>(&batch.data[0] + data_offset);
+            block_z.avail_out = uInt(size);
+            const int res = inflate(&block_z, Z_FINISH);
+            if (res != Z_STREAM_END || block_z.avail_out != 0 ||
+                crc32(0, reinterpret_cast<Bytef*>(&batch.data[0] + data_offset), uInt(size)) != read_uint32(end - 8)) {
+                inflateEnd(&block_z);
+                throw std::runtime_error("bgzf block decoding failed");
+            }
+            data_offset += size;
+        }
+        inflateEnd(&block_z);
+    }
+
+    static uint32_t read_uint32(const char* p) {
+        const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+        return u[0] | (u[1] << 8) | (u[2] << 16) | (uint32_t(u[3]) << 24);
+    }
+
+    void inflate_batches() {
+        try {
+            while (true) {
+                Batch batch;
+                size_t batch_idx;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    while (!stopping && !all_read && batch_count >= next_batch + max_pending) {
+                        changed.wait(lock);
+                    }
+                    if (stopping || all_read) {
+                        return;
+                    }
+                    if (!read_batch(batch)) {
+                        all_read = true;
+                        changed.notify_all();
+                        return;
+                    }
+                    batch_idx = batch_count++;
+                }
+
+                inflate_batch(batch);
+
+                std::lock_guard<std::mutex> lock(mutex);
+                ready[batch_idx] = std::move(batch);
+                changed.notify_all();
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+            all_read = true;
+            changed.notify_all();
+        }
+    }
+};
@@ -29,6 +29,7 @@
 #include "hash.h"
 #include "seq_transform.h"
 #include "tax_id_tree.h"
+#include "kmers.h"
 
 struct KmerIO
 {
@@ -45,12 +46,11 @@ struct KmerIO
 
     static void print_kmers(const Kmers &kmers, int kmer_len)
     {
-	    for (auto &kmer : kmers.storage)
+	    kmers.for_all_kmers_do([&](hash_t kmer, tax_id_t tax_id)
 	    {
-		    auto tax_id = kmer.second;
 		    if (tax_id != TaxIdTree::ROOT)
-			    std::cout << str_kmer(kmer.first, kmer_len) << '\t' << tax_id << std::endl;
-	    }
+			    std::cout << str_kmer(kmer, kmer_len) << '\t' << tax_id << std::endl;
+	    });
     }
 };
 
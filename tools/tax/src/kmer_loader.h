@@ -53,19 +53,18 @@ struct KmerLoader
 	{
         auto reader = Reader::create(accession, reader_params);
 
-        const int THREADS = 4;
-        #pragma omp parallel num_threads(THREADS)
+        #pragma omp parallel
         {
-            std::vector<Reader::Fragment> chunk;
+            Reader::Chunk chunk; // kmers are taken right from the chunk buffer
             bool done = false;
             while (!done) 
             {
                 #pragma omp critical (read)
                 {
-                    done = !reader->read_many(chunk);
+                    done = !reader->read_chunk(chunk, Reader::DEFAULT_CHUNK_SIZE);
                 }
 
-                for (auto& frag: chunk) 
+                for (size_t i = 0; i < chunk.size(); i++) 
                 {
                     auto lambda = [&](typename KmerMap::hash_t hash) 
                     {
@@ -74,7 +73,8 @@ struct KmerLoader
                         return true;
                     };
 
-                    Hash<typename KmerMap::hash_t>::for_all_hashes_do(frag.bases, kmers.kmer_len, lambda);
+                    auto bases = chunk.bases(i);
+                    Hash<typename KmerMap::hash_t>::for_all_hashes_do(bases.s, bases.len, kmers.kmer_len, lambda);
                 }
             }
         }
@@ -1,24 +1,25 @@
 #ifndef KMER_MAP_H_INCLUDED
 #define KMER_MAP_H_INCLUDED
 
-#include <unordered_map>
-#include <map>
 #include <mutex>
+#include <atomic>
+#include <memory>
 #include <vector>
 #include <iostream>
 #include "seq_transform.h"
 #include "hash.h"
 #include "omp_adapter.h"
 
-template <class _hash_t, int _kmer_len, int _count_buckets>
-struct KmerMap 
+// kmer -> count, open addressing with linear probing, split into shards
+// add() locks one shard, so that shards can grow; reads and remove/restore take no locks and must not run with adds
+// kmer is stored in canonical form, its original orientation is the other one only if the kmer was never added as is
+template <class _hash_t, int _kmer_len, int _shards>
+struct KmerMap
 {
 	typedef _hash_t hash_t;
-	static const int COUNT_BUCKETS = _count_buckets;
+	static const int SHARDS = _shards;
 	static const int kmer_len = _kmer_len;
 
-	std::mutex kmer_mutex;
-
 	struct Count
 	{
 		unsigned int reverse : 1;
@@ -30,15 +31,12 @@ struct KmerMap
 		Count(int count = 0) : count(count), reverse(0), complement(0), deleted(0) {}
 	};
 
-	typedef std::unordered_map<hash_t, Count> CountMap;
-	std::vector< CountMap > count;
-	std::vector< std::mutex > bucket_mutex;
-	std::vector<long long unsigned int> bucket_weight;
-	std::vector<size_t> bucket_frequent;
-
-	KmerMap() : count(COUNT_BUCKETS), bucket_mutex(COUNT_BUCKETS), bucket_weight(COUNT_BUCKETS), bucket_frequent(COUNT_BUCKETS)
+	KmerMap() : shards(SHARDS)
 	{
 		static_assert(sizeof(Count) == sizeof(int), "sizeof(Count) == sizeof(int)");
+		static_assert((SHARDS & (SHARDS - 1)) == 0, "shards should be a power of 2");
+		for (auto &shard : shards)
+			shard.resize(INITIAL_CAPACITY);
 	}
 
 	void add(hash_t hash)
@@ -46,39 +44,40 @@ struct KmerMap
 		bool complement = false, reverse = false;
 		hash = seq_transform<hash_t>::min_hash_variant(hash, kmer_len, &complement, &reverse);
 
-		auto bucket = get_count_bucket(hash);
-		bucket_mutex[bucket].lock(); // todo: try atomic?
-		auto &c = count[bucket][hash];
+		auto mixed = mix(hash);
+		auto &shard = shards[shard_of(mixed)];
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		if ((shard.size + 1) * MAX_LOAD_DIVIDER > shard.capacity * MAX_LOAD_MULTIPLIER)
+			shard.resize(shard.capacity * 2);
 
-		if (c.count == 0)
+		auto &slot = shard.slots[shard.find_or_empty(hash, mixed)];
+		auto word = slot.word.load(std::memory_order_relaxed);
+		if (word == 0)
 		{
-			c.complement = complement;
-			c.reverse = reverse;
+			slot.key = hash;
+			slot.word.store((1u << COUNT_SHIFT) | (complement ? COMPLEMENT_BIT : 0) | (reverse ? REVERSE_BIT : 0), std::memory_order_relaxed);
+			shard.size++;
 		}
+		else
+		{
+			if ((word >> COUNT_SHIFT) == 1)
+				shard.frequent++;
 
-		if (c.count == 1)
-			bucket_frequent[bucket]++;
-
-		if (c.count < Count::MAX_COUNT)
-			c.count++;
-
-		bucket_weight[bucket]++;
-		bucket_mutex[bucket].unlock();
-	}
+			if ((word >> COUNT_SHIFT) < Count::MAX_COUNT)
+				slot.word.fetch_add(1u << COUNT_SHIFT, std::memory_order_relaxed);
 
-	void reserve(size_t size, float max_load_factor = 4.0f) // todo: tune max load factor
-	{
-		for (auto &c : count)
-		{
-			c.max_load_factor(max_load_factor);
-			c.reserve(size/count.size());
+			if (!complement && !reverse) // seen as is at least once, does not depend on the order of adds
+				slot.word.fetch_and(~(COMPLEMENT_BIT | REVERSE_BIT), std::memory_order_relaxed);
 		}
+
+		shard.weight++;
 	}
 
-	static unsigned int get_count_bucket(hash_t hash)
+	void reserve(size_t size)
 	{
-		auto bucket = (hash >> 2) % COUNT_BUCKETS; // different last letter sequence should have the same bucket
-		return bucket;
+		for (auto &shard : shards)
+			if (shard.capacity * MAX_LOAD_MULTIPLIER < size / SHARDS * MAX_LOAD_DIVIDER)
+				shard.resize(capacity_for(size / SHARDS));
 	}
 
 	unsigned int get(hash_t hash) const
@@ -89,38 +88,22 @@ struct KmerMap
 
 	Count get_full(hash_t hash) const
 	{
-		auto &bucket = count[get_count_bucket(hash)];
-		auto it = bucket.find(hash);
-		if (it == bucket.end())
-			return Count();
-
-		return it->second;
+		auto slot = find(hash);
+		return slot ? to_count(slot->word.load(std::memory_order_relaxed)) : Count();
 	}
 
 	void remove(hash_t hash)
 	{
-		bool complement = false, reverse = false;
-		hash = seq_transform<hash_t>::min_hash_variant(hash, kmer_len, &complement, &reverse);
-
-		auto &bucket = count[get_count_bucket(hash)];
-		auto it = bucket.find(hash);
-		if (it == bucket.end() || it->second.deleted)
-			return;
-
-		it->second.deleted = 1;
+		hash = seq_transform<hash_t>::min_hash_variant(hash, kmer_len);
+		if (auto slot = find(hash))
+			slot->word.fetch_or(DELETED_BIT, std::memory_order_relaxed);
 	}
 
 	void restore(hash_t hash)
 	{
-		bool complement = false, reverse = false;
-		hash = seq_transform<hash_t>::min_hash_variant(hash, kmer_len, &complement, &reverse);
-
-		auto &bucket = count[get_count_bucket(hash)];
-		auto it = bucket.find(hash);
-		if (it == bucket.end() || !it->second.deleted)
-			return;
-
-		it->second.deleted = 0;
+		hash = seq_transform<hash_t>::min_hash_variant(hash, kmer_len);
+		if (auto slot = find(hash))
+			slot->word.fetch_and(~DELETED_BIT, std::memory_order_relaxed);
 	}
 
 	unsigned int coverage_of(hash_t hash) const
@@ -141,8 +124,8 @@ struct KmerMap
 //		if (!c.count)
 	//		throw std::runtime_error("originally_reversed test for non-existing");
 
-		*orig_complement = complement != c.complement; 
-		*orig_reverse = reverse != c.reverse; 
+		*orig_complement = complement != c.complement;
+		*orig_reverse = reverse != c.reverse;
 	}
 
 	bool originally_complement(hash_t hash) const
@@ -162,8 +145,8 @@ struct KmerMap
 	long long unsigned int total_weight() const
 	{
 		long long unsigned int sum = 0;
-		for (auto &w : bucket_weight)
-			sum += w;
+		for (auto &shard : shards)
+			sum += shard.weight;
 
 		return sum;
 	}
@@ -171,51 +154,161 @@ struct KmerMap
 	size_t size() const
 	{
 		size_t sum = 0;
-		for (auto &bucket : count)
-			sum += bucket.size();
-		
+		for (auto &shard : shards)
+			sum += shard.size;
+
 		return sum;
 	}
-			
-	void optimize(int min_count = 2) // todo: multitheading
+
+	// drops kmers seen less than min_count times, shard by shard, so that memory grows by a few shards at most
+	void optimize(int min_count = 2)
 	{
-		const float MAX_OPTIMIZED_LOAD_FACTOR = 4.0f;
-        const int THREADS = 4; // part by part, not everything at the same time
-		#pragma omp parallel for num_threads(THREADS)
-		for (int bucket_i = 0; bucket_i < COUNT_BUCKETS; bucket_i++)
+		#pragma omp parallel for schedule(dynamic, 1)
+		for (int shard_i = 0; shard_i < SHARDS; shard_i++)
 		{
-			CountMap new_bucket;
-			new_bucket.max_load_factor(MAX_OPTIMIZED_LOAD_FACTOR);
-			new_bucket.reserve(bucket_frequent[bucket_i]);
-//			LOG("reserving " << bucket_frequent[bucket_i]);
-			auto &bucket = count[bucket_i];
-			bucket_weight[bucket_i] = 0;
-
-			for (auto c = bucket.begin(); c != bucket.end(); c++)
-				if (c->second.count >= min_count)
+			auto &shard = shards[shard_i];
+			Shard optimized;
+			optimized.resize(capacity_for(min_count <= 1 ? shard.size : shard.frequent));
+			for (size_t i = 0; i < shard.capacity; i++)
+			{
+				auto &slot = shard.slots[i];
+				auto word = slot.word.load(std::memory_order_relaxed);
+				if (word != 0 && int(word >> COUNT_SHIFT) >= min_count)
 				{
-					new_bucket.insert(*c);
-					bucket_weight[bucket_i] += c->second.count;
+					optimized.insert(slot.key, mix(slot.key), word);
+					optimized.weight += word >> COUNT_SHIFT;
+					optimized.frequent += (word >> COUNT_SHIFT) >= 2;
 				}
+			}
 
-//			LOG("result size " << new_bucket.size());
-			bucket.swap(new_bucket);
+			shard.swap(optimized);
 		}
 	}
 
 	template <class Lambda>
 	void for_every_kmer_do(Lambda &&lambda) const // todo: decide what to do with deleted
 	{
-		for (auto &bucket : count)
-		for (auto &map_element: bucket)
-			if (!map_element.second.deleted)
-				lambda(map_element.first, map_element.second.count);
+		for (auto &shard : shards)
+			for (size_t i = 0; i < shard.capacity; i++)
+			{
+				auto word = shard.slots[i].word.load(std::memory_order_relaxed);
+				if (word != 0 && !(word & DELETED_BIT))
+					lambda(shard.slots[i].key, word >> COUNT_SHIFT);
+			}
+	}
+
+private:
+	// count is packed next to the key, zero word is an empty slot
+	static const unsigned int REVERSE_BIT = 1, COMPLEMENT_BIT = 2, DELETED_BIT = 4, COUNT_SHIFT = 3;
+	static const size_t INITIAL_CAPACITY = 64;
+	static const size_t MAX_LOAD_MULTIPLIER = 7, MAX_LOAD_DIVIDER = 10;
+
+	struct Slot
+	{
+		hash_t key;
+		std::atomic<unsigned int> word;
+		Slot() : key(0), word(0) {}
+	};
+
+	struct Shard
+	{
+		std::unique_ptr<Slot[]> slots;
+		size_t capacity, size, frequent; // frequent - seen more than once
+		long long unsigned int weight;
+		std::mutex mutex;
+
+		Shard() : capacity(0), size(0), frequent(0), weight(0) {}
+
+		// slot with the hash or the empty slot where it goes
+		size_t find_or_empty(hash_t hash, uint64_t mixed) const
+		{
+			size_t mask = capacity - 1;
+			for (size_t i = (mixed >> 16) & mask; ; i = (i + 1) & mask)
+				if (slots[i].word.load(std::memory_order_relaxed) == 0 || slots[i].key == hash)
+					return i;
+		}
+
+		void insert(hash_t hash, uint64_t mixed, unsigned int word)
+		{
+			auto &slot = slots[find_or_empty(hash, mixed)];
+			slot.key = hash;
+			slot.word.store(word, std::memory_order_relaxed);
+			size++;
+		}
+
+		void resize(size_t new_capacity) // power of 2
+		{
+			std::unique_ptr<Slot[]> old(new Slot[new_capacity]);
+			old.swap(slots);
+			auto old_capacity = capacity;
+			capacity = new_capacity;
+			size = 0;
+			for (size_t i = 0; i < old_capacity; i++)
+			{
+				auto word = old[i].word.load(std::memory_order_relaxed);
+				if (word != 0)
+					insert(old[i].key, mix(old[i].key), word);
+			}
+		}
+
+		void swap(Shard &other)
+		{
+			slots.swap(other.slots);
+			std::swap(capacity, other.capacity);
+			std::swap(size, other.size);
+			std::swap(frequent, other.frequent);
+			std::swap(weight, other.weight);
+		}
+	};
+
+	std::vector<Shard> shards;
+
+	static uint64_t fold(unsigned int hash) { return hash; }
+	static uint64_t fold(uint64_t hash) { return hash; }
+	static uint64_t fold(__uint128_t hash) { return uint64_t(hash) ^ uint64_t(hash >> 64); }
+
+	static uint64_t mix(hash_t hash)
+	{
+		auto h = fold(hash) * 0x9E3779B97F4A7C15ull;
+		return h ^ (h >> 29);
+	}
+
+	static size_t shard_of(uint64_t mixed) { return mixed & (SHARDS - 1); }
+
+	static size_t capacity_for(size_t size)
+	{
+		size_t capacity = INITIAL_CAPACITY;
+		while (capacity * MAX_LOAD_MULTIPLIER < (size + 1) * MAX_LOAD_DIVIDER)
+			capacity *= 2;
+
+		return capacity;
+	}
+
+	static Count to_count(unsigned int word)
+	{
+		Count c(word >> COUNT_SHIFT);
+		c.reverse = (word & REVERSE_BIT) != 0;
+		c.complement = (word & COMPLEMENT_BIT) != 0;
+		c.deleted = (word & DELETED_BIT) != 0;
+		return c;
 	}
 
+	const Slot *find(hash_t hash) const
+	{
+		auto mixed = mix(hash);
+		auto &shard = shards[shard_of(mixed)];
+		auto &slot = shard.slots[shard.find_or_empty(hash, mixed)];
+		return slot.word.load(std::memory_order_relaxed) != 0 ? &slot : nullptr;
+	}
+
+	Slot *find(hash_t hash)
+	{
+		return const_cast<Slot*>(static_cast<const KmerMap*>(this)->find(hash));
+	}
 };
 
-//typedef KmerMap<__uint128_t, 64, 1024> KmerMap64;
-typedef KmerMap<uint64_t, 32, 64> KmerMap32; // todo: tune buckets
-//typedef KmerMap<unsigned int, 16, 1024> KmerMap16;
+typedef KmerMap<__uint128_t, 64, 4096> KmerMap64;
+typedef KmerMap<uint64_t, 32, 4096> KmerMap32;
+typedef KmerMap<unsigned int, 16, 1024> KmerMap16;
 
 #endif
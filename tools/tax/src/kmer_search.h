@@ -0,0 +1,277 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#ifndef KMER_SEARCH_H_INCLUDED
+#define KMER_SEARCH_H_INCLUDED
+
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include "log.h"
+#include "hash.h"
+
+// how sorted kmers are searched
+// BUCKET - binary search inside small buckets addressed by top bits of the kmer
+// INTERPOLATION - position is interpolated inside ~16x larger buckets, then short linear scan. much smaller lookup table
+enum class SearchLayout { BUCKET, INTERPOLATION };
+
+inline SearchLayout search_layout_from(const std::string &name)
+{
+	if (name == "bucket")
+		return SearchLayout::BUCKET;
+
+	if (name == "interpolation")
+		return SearchLayout::INTERPOLATION;
+
+	throw std::runtime_error(std::string("unknown search layout ") + name);
+}
+
+inline const char *search_layout_name(SearchLayout layout)
+{
+	switch (layout)
+	{
+		case SearchLayout::BUCKET: return "bucket";
+		case SearchLayout::INTERPOLATION: return "interpolation";
+	}
+
+	return "unknown";
+}
+
+#if defined(__GNUC__)
+	#define KMER_SEARCH_PREFETCH(address) __builtin_prefetch(address)
+#else
+	#define KMER_SEARCH_PREFETCH(address)
+#endif
+
+// kmer of an array element, element is either kmer itself or has .kmer
+template <class C, class hash_t>
+struct KmerOf
+{
+	static hash_t of(const C &c) { return c.kmer; }
+};
+
+template <class hash_t>
+struct KmerOf<hash_t, hash_t>
+{
+	static hash_t of(hash_t hash) { return hash; }
+};
+
+template <class C, class hash_t>
+struct KmerSearch
+{
+	KmerSearch(const C *first, size_t count, int kmer_len, SearchLayout layout = SearchLayout::BUCKET) : first(first), count(count), kmer_len(kmer_len), layout(layout)
+	{
+		build_buckets(layout == SearchLayout::INTERPOLATION ? 64 : 5);
+	}
+
+	// returns nullptr if not found
+	const C *find(hash_t hash) const
+	{
+		auto bucket = bucket_of(hash);
+		return find_in(hash, bucket, first + buckets[bucket], first + buckets[bucket + 1]);
+	}
+
+	const C *end() const { return first + count; }
+
+	// bucket range of hash, its bounds are prefetched
+	std::pair<const C*, const C*> prefetch_bucket(hash_t hash) const
+	{
+		auto bucket = bucket_of(hash);
+		auto range = std::make_pair(first + buckets[bucket], first + buckets[bucket + 1]);
+		KMER_SEARCH_PREFETCH(range.first);
+		return range;
+	}
+
+	// first element not less than hash, range is from prefetch_bucket(hash)
+	static const C *lower_bound_in(std::pair<const C*, const C*> range, hash_t hash)
+	{
+		return std::lower_bound(range.first, range.second, hash, [](const C &c, hash_t hash) { return key(c) < hash; });
+	}
+
+	static const size_t BATCH_SIZE = 32;
+
+	// looks up to BATCH_SIZE hashes at once, memory accesses of all of them are issued before the first is resolved
+	// calls lambda(found element or nullptr, hash) in order, stops and returns false when lambda returns false
+	template <class Lambda>
+	bool find_batch(const hash_t *hashes, size_t count, Lambda &&lambda) const
+	{
+		assert(count <= BATCH_SIZE);
+		size_t bucket[BATCH_SIZE];
+		for (size_t i = 0; i < count; i++)
+		{
+			bucket[i] = bucket_of(hashes[i]);
+			KMER_SEARCH_PREFETCH(&buckets[bucket[i]]);
+		}
+
+		const C *from[BATCH_SIZE], *to[BATCH_SIZE];
+		for (size_t i = 0; i < count; i++)
+		{
+			from[i] = first + buckets[bucket[i]];
+			to[i] = first + buckets[bucket[i] + 1];
+			if (from[i] == to[i])
+				continue;
+
+			if (layout == SearchLayout::INTERPOLATION)
+				KMER_SEARCH_PREFETCH(interpolate(hashes[i], bucket[i], from[i], to[i]));
+			else
+			{
+				KMER_SEARCH_PREFETCH(from[i]);
+				KMER_SEARCH_PREFETCH(to[i] - 1);
+			}
+		}
+
+		for (size_t i = 0; i < count; i++)
+			if (!lambda(find_in(hashes[i], bucket[i], from[i], to[i]), hashes[i]))
+				return false;
+
+		return true;
+	}
+
+	// looks up canonical form of every kmer of seq, in batches
+	template <class Lambda>
+	void find_all_kmers(const char *seq, int len, Lambda &&lambda) const
+	{
+		find_all_kmers_at(seq, len, [&](const C *found, hash_t hash, int) { return lambda(found, hash); });
+	}
+
+	// same, lambda(found element or nullptr, hash, kmer position in seq)
+	template <class Lambda>
+	void find_all_kmers_at(const char *seq, int len, Lambda &&lambda) const
+	{
+		hash_t batch[BATCH_SIZE];
+		int batch_pos[BATCH_SIZE];
+		size_t batch_count = 0;
+		bool go_on = true;
+		auto resolve = [&](size_t count)
+			{
+				size_t i = 0;
+				return find_batch(batch, count, [&](const C *found, hash_t hash) { return lambda(found, hash, batch_pos[i++]); });
+			};
+
+		Hash<hash_t>::for_all_canonical_hashes_do(seq, len, kmer_len, [&](hash_t hash, int pos)
+			{
+				batch_pos[batch_count] = pos;
+				batch[batch_count++] = hash;
+				if (batch_count < BATCH_SIZE)
+					return true;
+
+				batch_count = 0;
+				go_on = resolve(BATCH_SIZE);
+				return go_on;
+			});
+
+		if (go_on && batch_count > 0)
+			resolve(batch_count);
+	}
+
+	template <class Lambda>
+	void find_all_kmers(const std::string &seq, Lambda &&lambda) const
+	{
+		find_all_kmers(seq.data(), int(seq.size()), lambda);
+	}
+
+private:
+	const C *first;
+	size_t count;
+	int kmer_len;
+	SearchLayout layout;
+
+	std::vector<size_t> buckets; // bucket i is [buckets[i], buckets[i + 1])
+	int bucket_shift;
+	double bucket_scale; // 2^-bucket_shift
+
+	static hash_t key(const C &c) { return KmerOf<C, hash_t>::of(c); }
+
+	size_t bucket_of(hash_t hash) const { return size_t(hash >> bucket_shift); }
+
+	void build_buckets(size_t per_bucket)
+	{
+		int bucket_bits = 1;
+		while ((count >> bucket_bits) > per_bucket && bucket_bits < kmer_len * 2)
+			bucket_bits++;
+
+		bucket_shift = kmer_len * 2 - bucket_bits;
+		bucket_scale = std::ldexp(1.0, -bucket_shift);
+
+		const size_t bucket_count = size_t(1) << bucket_bits;
+		LOG(search_layout_name(layout) << " search: " << bucket_count << " buckets, on average " << (float(count) / bucket_count) << " hashes per bucket");
+		buckets.resize(bucket_count + 1);
+
+		size_t idx = 0;
+		for (size_t bucket = 0; bucket < bucket_count; bucket++)
+		{
+			buckets[bucket] = idx;
+			while (idx < count && bucket_of(key(first[idx])) == bucket)
+			{
+				assert(idx == 0 || key(first[idx - 1]) <= key(first[idx]));
+				idx++;
+			}
+		}
+
+		buckets[bucket_count] = idx;
+	}
+
+	const C *find_in(hash_t hash, size_t bucket, const C *from, const C *to) const
+	{
+		if (layout == SearchLayout::INTERPOLATION)
+			return find_interpolation(hash, bucket, from, to);
+
+		auto it = std::lower_bound(from, to, hash, [](const C &c, hash_t hash) { return key(c) < hash; });
+		return (it == to || key(*it) != hash) ? nullptr : it;
+	}
+
+	// kmers are close to uniform inside the bucket
+	const C *interpolate(hash_t hash, size_t bucket, const C *from, const C *to) const
+	{
+		hash_t bucket_start = hash_t(bucket) << bucket_shift;
+		auto it = from + size_t(double(hash - bucket_start) * bucket_scale * (to - from));
+		return it >= to ? to - 1 : it;
+	}
+
+	const C *find_interpolation(hash_t hash, size_t bucket, const C *from, const C *to) const
+	{
+		if (from == to)
+			return nullptr;
+
+		auto it = interpolate(hash, bucket, from, to);
+		if (key(*it) < hash)
+		{
+			while (++it < to && key(*it) < hash)
+				;
+		}
+		else
+		{
+			while (it > from && key(*(it - 1)) >= hash)
+				--it;
+		}
+
+		return (it == to || key(*it) != hash) ? nullptr : it;
+	}
+};
+
+#endif
@@ -30,42 +30,83 @@
 #include <set>
 #include <string>
 #include <map>
+#include <vector>
+#include <mutex>
+#include <algorithm>
 #include <unordered_map>
 #include "tax_id_tree.h"
 
 typedef uint64_t hash_t;
 
+// kmer -> tax_id, sharded so that several threads can add kmers at once
+// lookups take no locks and must not run concurrently with adds
 struct Kmers
 {
-	const TaxIdTree &tax_id_tree;
+	const FlatTaxIdTree &tax_id_tree;
 
-	std::unordered_map<hash_t, tax_id_t> storage;
+	struct Shard
+	{
+		std::unordered_map<hash_t, tax_id_t> storage;
+		mutable std::mutex mutex;
+	};
+
+	static const int SHARD_BITS = 8;
+	std::vector<Shard> shards;
+
+	Kmers(const FlatTaxIdTree &tax_id_tree) : tax_id_tree(tax_id_tree), shards(1 << SHARD_BITS)
+	{
+		for (auto &shard : shards)
+			shard.storage.reserve((128*1024*1024) >> SHARD_BITS); // todo: tune
+	}
 
-	Kmers(const TaxIdTree &tax_id_tree) : tax_id_tree(tax_id_tree)
+	static size_t shard_of(hash_t kmer)
 	{
-		storage.reserve(128*1024*1024); // todo: tune
+		return (kmer * 0x9E3779B97F4A7C15ull) >> (64 - SHARD_BITS); // kmers differ in low bits mostly
+	}
+
+	size_t size() const
+	{
+		size_t count = 0;
+		for (auto &shard : shards)
+		{
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			count += shard.storage.size();
+		}
+
+		return count;
 	}
 
 	bool has_kmer(hash_t kmer) const
 	{
+		auto &storage = shards[shard_of(kmer)].storage;
 		auto it = storage.find(kmer);
 		return it != storage.end();
 	}
 
 	void add_kmer(hash_t kmer, tax_id_t tax_id)
 	{
-		auto &at = storage[kmer];
-		if (at == tax_id) // todo: remove?
-			return;
+		auto &shard = shards[shard_of(kmer)];
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		add_to(shard, kmer, tax_id);
+	}
 
-		if (at == 0)
-			at = tax_id;
-		else
-			at = tax_id_tree.consensus_of(tax_id, at); // todo: avoid writing if match?
+	// same as add_kmer for every kmer, but takes every shard lock once; reorders kmers
+	void add_kmers(std::vector<hash_t> &kmers, tax_id_t tax_id)
+	{
+		std::sort(kmers.begin(), kmers.end(), [](hash_t a, hash_t b) { return shard_of(a) < shard_of(b); });
+		for (size_t from = 0; from < kmers.size(); )
+		{
+			auto shard_index = shard_of(kmers[from]);
+			auto &shard = shards[shard_index];
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			for (; from < kmers.size() && shard_of(kmers[from]) == shard_index; from++)
+				add_to(shard, kmers[from], tax_id);
+		}
 	}
 
 	bool has_kmer_but_not_tax(hash_t kmer, tax_id_t tax_id) const
 	{
+		auto &storage = shards[shard_of(kmer)].storage;
 		auto it = storage.find(kmer);
 		if (it == storage.end())
 			return false;
@@ -77,6 +118,27 @@ struct Kmers
 		return !tax_id_tree.a_sub_b(tax_id, stored_tax_id);
 	}
 
+	template <class Lambda>
+	void for_all_kmers_do(Lambda &&lambda) const // lambda(kmer, tax_id)
+	{
+		for (auto &shard : shards)
+			for (auto &kmer : shard.storage)
+				lambda(kmer.first, kmer.second);
+	}
+
+private:
+	// consensus is commutative and associative, so the result does not depend on the order of adds
+	void add_to(Shard &shard, hash_t kmer, tax_id_t tax_id)
+	{
+		auto &at = shard.storage[kmer];
+		if (at == tax_id) // todo: remove?
+			return;
+
+		if (at == 0)
+			at = tax_id;
+		else
+			at = tax_id_tree.consensus_of(tax_id, at); // todo: avoid writing if match?
+	}
 };
 
 #endif
@@ -0,0 +1,182 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#ifndef KWAY_MERGE_H_INCLUDED
+#define KWAY_MERGE_H_INCLUDED
+
+#include <vector>
+#include <algorithm>
+#include <assert.h>
+#include "omp_adapter.h"
+
+template <class T>
+struct SortedRun
+{
+	const T *first, *last;
+	SortedRun(const T *first, const T *last) : first(first), last(last) {}
+	size_t size() const { return last - first; }
+};
+
+// merges sorted runs into out, equal elements keep the order of their runs
+// output is cut into cache sized parts by sampled splitter values, the parts are merged in parallel
+// within a part the pieces of the runs are gathered and merged pairwise, log2(runs) passes over the part
+// convert(value, run index) makes an output element, Out is compared with <
+template <class T, class Out, class Convert>
+void kway_merge(const std::vector<SortedRun<T>> &runs, Out *out, Convert &&convert)
+{
+	size_t total = 0;
+	for (auto &run : runs)
+		total += run.size();
+
+	if (total == 0)
+		return;
+
+	const size_t PART_SIZE = std::max(size_t(32768), 4 * runs.size()); // bounds below take no more than a quarter of the output
+	const size_t SAMPLES_PER_PART = 16;
+	size_t parts = std::max(total / PART_SIZE, size_t(1));
+
+	std::vector<T> splitters;
+	if (parts > 1)
+	{
+		size_t step = std::max(total / (parts * SAMPLES_PER_PART), size_t(1));
+		std::vector<T> samples;
+		for (auto &run : runs)
+			for (size_t i = step / 2; i < run.size(); i += step)
+				samples.push_back(run.first[i]);
+
+		std::sort(samples.begin(), samples.end());
+		for (size_t p = 1; p < parts && !samples.empty(); p++)
+			splitters.push_back(samples[p * samples.size() / parts]);
+
+		splitters.erase(std::unique(splitters.begin(), splitters.end(), [](const T &a, const T &b) { return !(a < b) && !(b < a); }), splitters.end());
+		parts = splitters.size() + 1;
+	}
+
+	// bounds[p * runs.size() + r] - where part p starts in run r, found by one sequential pass over every run
+	std::vector<const T*> bounds((parts + 1) * runs.size());
+	#pragma omp parallel for schedule(dynamic, 16)
+	for (size_t r = 0; r < runs.size(); r++)
+	{
+		auto pos = runs[r].first;
+		bounds[r] = pos;
+		for (size_t p = 1; p < parts; p++)
+		{
+			while (pos != runs[r].last && *pos < splitters[p - 1])
+				pos++;
+
+			bounds[p * runs.size() + r] = pos;
+		}
+
+		bounds[parts * runs.size() + r] = runs[r].last;
+	}
+
+	auto part_begin = [&](size_t p, size_t r) { return bounds[p * runs.size() + r]; };
+
+	std::vector<size_t> part_offset(parts + 1, 0);
+	for (size_t p = 0; p < parts; p++)
+	{
+		part_offset[p + 1] = part_offset[p];
+		for (size_t r = 0; r < runs.size(); r++)
+			part_offset[p + 1] += part_begin(p + 1, r) - part_begin(p, r);
+	}
+
+	#pragma omp parallel
+	{
+		std::vector<Out> buffer;
+		std::vector<size_t> pieces, merged_pieces;
+
+		#pragma omp for schedule(dynamic, 1)
+		for (size_t p = 0; p < parts; p++)
+		{
+			Out *part = out + part_offset[p];
+			size_t part_size = part_offset[p + 1] - part_offset[p];
+
+			pieces.clear();
+			size_t pos = 0;
+			for (size_t r = 0; r < runs.size(); r++)
+			{
+				auto from = part_begin(p, r), to = part_begin(p + 1, r);
+				if (from == to)
+					continue;
+
+				pieces.push_back(pos);
+				for (auto it = from; it != to; it++)
+					part[pos++] = convert(*it, r);
+			}
+
+			pieces.push_back(pos);
+			assert(pos == part_size);
+
+			buffer.resize(part_size);
+			Out *src = part, *dst = buffer.data();
+			while (pieces.size() > 2)
+			{
+				merged_pieces.clear();
+				for (size_t i = 0; i + 1 < pieces.size(); i += 2)
+				{
+					merged_pieces.push_back(pieces[i]);
+					if (i + 2 < pieces.size())
+						std::merge(src + pieces[i], src + pieces[i + 1], src + pieces[i + 1], src + pieces[i + 2], dst + pieces[i]);
+					else
+						std::copy(src + pieces[i], src + pieces[i + 1], dst + pieces[i]);
+				}
+
+				merged_pieces.push_back(pieces.back());
+				pieces.swap(merged_pieces);
+				std::swap(src, dst);
+			}
+
+			if (src != part)
+				std::copy(src, src + part_size, part);
+		}
+	}
+}
+
+// sorts chunks of v in parallel, then merges them, needs a copy of v
+template <class T>
+void parallel_sort(std::vector<T> &v)
+{
+	size_t chunks = std::max(omp_get_max_threads(), 1);
+	if (chunks == 1 || v.size() < 65536)
+	{
+		std::sort(v.begin(), v.end());
+		return;
+	}
+
+	#pragma omp parallel for
+	for (size_t c = 0; c < chunks; c++)
+		std::sort(v.begin() + v.size() * c / chunks, v.begin() + v.size() * (c + 1) / chunks);
+
+	std::vector<SortedRun<T>> runs;
+	for (size_t c = 0; c < chunks; c++)
+		runs.push_back(SortedRun<T>(v.data() + v.size() * c / chunks, v.data() + v.size() * (c + 1) / chunks));
+
+	std::vector<T> sorted(v.size());
+	kway_merge(runs, sorted.data(), [](const T &x, size_t) { return x; });
+	v.swap(sorted);
+}
+
+#endif
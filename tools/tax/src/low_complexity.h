@@ -0,0 +1,168 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#ifndef LOW_COMPLEXITY_H_INCLUDED
+#define LOW_COMPLEXITY_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <stdint.h>
+#include "omp_adapter.h"
+
+// repeat score of kmers: positions ending a run of 5 equal letters or a 9 letter run of period 2
+// kmers scoring at least min_score in either orientation are low complexity
+struct LowComplexity
+{
+	static int predicted(const std::string &kmer)
+	{
+		int pred = 0;
+
+		for (int i = 4; i<int(kmer.length()); i++)
+			if (kmer[i] == kmer[i - 1] && kmer[i - 1] == kmer[i - 2] && kmer[i - 2] == kmer[i - 3] && kmer[i - 3] == kmer[i - 4])
+				pred++;
+			else if (i >= 8 && kmer[i] == kmer[i - 2] && kmer[i - 2] == kmer[i - 4] && kmer[i - 4] == kmer[i - 6] && kmer[i - 6] == kmer[i - 8])
+				pred++;
+
+		return pred;
+	}
+
+	// same score of a 2 bit packed kmer, first letter in the highest bits
+	static int predicted(uint64_t kmer, int kmer_len)
+	{
+		auto r = repeats(kmer, kmer_len);
+		return popcount(r.run | r.period2);
+	}
+
+	// score of the reverse complement, complement does not change it and reverse counts repeats by their first letter
+	static int reverse_predicted(uint64_t kmer, int kmer_len)
+	{
+		auto r = repeats(kmer, kmer_len);
+		return popcount((r.run << 8) | (r.period2 << 16));
+	}
+
+	// either orientation of the kmer scores too high, so canonical kmers give the same answer as the original ones
+	static bool is_low_complexity(uint64_t kmer, int kmer_len)
+	{
+		auto r = repeats(kmer, kmer_len);
+		auto score = min_score(kmer_len);
+		return popcount(r.run | r.period2) >= score || popcount((r.run << 8) | (r.period2 << 16)) >= score;
+	}
+
+	static int min_score(int kmer_len)
+	{
+		return 13 * kmer_len / 32; // const 13 was designed for 32 bp kmers
+	}
+
+	// drops low complexity kmers keeping the order of others, returns how many were dropped
+	// blocks are compacted in parallel, then moved together
+	template <class C>
+	static size_t filter(std::vector<C> &kmers, int kmer_len)
+	{
+		if (kmers.empty())
+			return 0;
+
+		if (kmer_len < 1 || kmer_len > 32)
+			throw std::runtime_error("LowComplexity:: kmer_len should be 1-32");
+
+		const size_t BLOCK = 1 << 16;
+		const auto count = kmers.size();
+		const auto blocks = (count + BLOCK - 1) / BLOCK;
+		std::vector<size_t> kept(blocks);
+
+		#pragma omp parallel for schedule(dynamic, 16)
+		for (size_t block = 0; block < blocks; block++)
+		{
+			auto from = block * BLOCK, to = std::min(count, from + BLOCK), out = from;
+			for (auto i = from; i < to; i++)
+				if (!is_low_complexity(uint64_t(kmer_of(kmers[i])), kmer_len))
+					kmers[out++] = kmers[i];
+
+			kept[block] = out - from;
+		}
+
+		size_t out = 0;
+		for (size_t block = 0; block < blocks; block++)
+		{
+			if (out != block * BLOCK)
+				memmove(&kmers[out], &kmers[block * BLOCK], kept[block] * sizeof(C));
+			out += kept[block];
+		}
+
+		kmers.resize(out);
+		return count - out;
+	}
+
+private:
+	// bit 2 * g is set for repeats ending at letter g, counted from the last one
+	struct Repeats
+	{
+		uint64_t run, period2;
+	};
+
+	// bit 2 * g is set in equal1 if letter g equals the one before it, in equal2 - the one 2 letters before
+	static Repeats repeats(uint64_t kmer, int kmer_len)
+	{
+		auto equal1 = equal_letters(kmer ^ (kmer >> 2)) & letters_mask(kmer_len - 1);
+		auto equal2 = equal_letters(kmer ^ (kmer >> 4)) & letters_mask(kmer_len - 2);
+		Repeats r;
+		r.run = equal1 & (equal1 >> 2) & (equal1 >> 4) & (equal1 >> 6);
+		r.period2 = equal2 & (equal2 >> 4) & (equal2 >> 8) & (equal2 >> 12);
+		return r;
+	}
+
+	// low bit of every 2 bit group is set if the group is 0
+	static uint64_t equal_letters(uint64_t x)
+	{
+		return ~(x | (x >> 1)) & 0x5555555555555555ull;
+	}
+
+	// low bits of the last count letters
+	static uint64_t letters_mask(int count)
+	{
+		return count <= 0 ? 0 : (count >= 32 ? ~0ull : (1ull << (2 * count)) - 1);
+	}
+
+	static int popcount(uint64_t x)
+	{
+#if defined(__GNUC__)
+		return __builtin_popcountll(x);
+#else
+		int count = 0;
+		for (; x; x &= x - 1)
+			count++;
+		return count;
+#endif
+	}
+
+	template <class C>
+	static auto kmer_of(const C &c) -> decltype(c.kmer) { return c.kmer; }
+	static uint64_t kmer_of(uint64_t kmer) { return kmer; }
+};
+
+#endif
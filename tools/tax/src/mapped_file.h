@@ -0,0 +1,205 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#ifndef MAPPED_FILE_H_INCLUDED
+#define MAPPED_FILE_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdexcept>
+#include <cstdio>
+#include <cstddef>
+#include <stdint.h>
+#if _WINDOWS
+#include <process.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// read-only view of the whole file
+// pages are shared with other processes mapping the same file
+struct MappedFile
+{
+	MappedFile(const std::string &filename) : ptr(nullptr), len(0)
+	{
+#if _WINDOWS
+		std::ifstream f(filename, std::ios::binary | std::ios::in);
+		if (f.fail())
+			throw std::runtime_error(std::string("cannot open file ") + filename);
+
+		f.seekg(0, std::ios::end);
+		len = f.tellg();
+		f.seekg(0, std::ios::beg);
+		buffer.resize(len);
+		f.read(&buffer[0], len);
+		if (!f)
+			throw std::runtime_error(std::string("cannot read file ") + filename);
+
+		ptr = &buffer[0];
+#else
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+			throw std::runtime_error(std::string("cannot open file ") + filename);
+
+		struct stat st;
+		if (fstat(fd, &st) != 0)
+		{
+			close(fd);
+			throw std::runtime_error(std::string("cannot stat file ") + filename);
+		}
+
+		len = st.st_size;
+		if (len > 0)
+		{
+			void *p = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+			if (p == MAP_FAILED)
+			{
+				close(fd);
+				throw std::runtime_error(std::string("cannot mmap file ") + filename);
+			}
+			ptr = (const char*)p;
+		}
+
+		close(fd); // mapping stays valid
+#endif
+	}
+
+	~MappedFile()
+	{
+#if ! _WINDOWS
+		if (ptr)
+			munmap((void*)ptr, len);
+#endif
+	}
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator = (const MappedFile &) = delete;
+
+	const char *data() const { return ptr; }
+	size_t size() const { return len; }
+
+private:
+	const char *ptr;
+	size_t len;
+#if _WINDOWS
+	std::vector<char> buffer;
+#endif
+};
+
+// headers of mapped file formats end with a checksum of the rest of the header
+// H is a plain struct of size_t fields with checksum the last one
+struct MappedHeader
+{
+	template <class H>
+	static size_t checksum(const H &header) // fnv1a of everything before checksum
+	{
+		static_assert(offsetof(H, checksum) + sizeof(size_t) == sizeof(H), "checksum should be the last field of the header");
+		const unsigned char *p = (const unsigned char*)&header;
+		uint64_t h = 14695981039346656037UL;
+		for (size_t i = 0; i < offsetof(H, checksum); i++)
+			h = (h ^ p[i]) * 1099511628211;
+
+		return h;
+	}
+
+	// header with magic and version fields at the start of the file, what - name of the format for messages
+	template <class H>
+	static H read(const MappedFile &file, size_t magic, size_t version, const std::string &what, const std::string &filename)
+	{
+		if (file.size() < sizeof(H))
+			throw std::runtime_error(what + " is truncated " + filename);
+
+		auto header = *(const H*)file.data();
+		if (header.magic != magic || header.version != version)
+			throw std::runtime_error("not a " + what + " " + filename);
+
+		if (header.checksum != checksum(header))
+			throw std::runtime_error(what + " header checksum mismatch");
+
+		return header;
+	}
+};
+
+// file to be mapped is written under a temporary name and renamed into place when complete
+// processes mapping the previous file keep their pages, crash while writing leaves no half written file
+struct ReplacingFile
+{
+	ReplacingFile(const std::string &filename) : filename(filename), temp_filename(filename + ".tmp." + std::to_string(pid())), committed(false)
+	{
+		f.open(temp_filename, std::ios::binary | std::ios::out);
+		if (f.fail())
+			throw std::runtime_error(std::string("cannot create file ") + temp_filename);
+	}
+
+	~ReplacingFile()
+	{
+		if (!committed)
+		{
+			f.close();
+			std::remove(temp_filename.c_str());
+		}
+	}
+
+	ReplacingFile(const ReplacingFile &) = delete;
+	ReplacingFile &operator = (const ReplacingFile &) = delete;
+
+	std::ofstream &stream() { return f; }
+
+	void commit()
+	{
+		f.close();
+		if (!f)
+			throw std::runtime_error(std::string("cannot write file ") + temp_filename);
+
+#if _WINDOWS
+		std::remove(filename.c_str()); // rename does not replace there
+#endif
+		if (std::rename(temp_filename.c_str(), filename.c_str()) != 0)
+			throw std::runtime_error(std::string("cannot rename ") + temp_filename + " to " + filename);
+
+		committed = true;
+	}
+
+private:
+	std::string filename, temp_filename;
+	std::ofstream f;
+	bool committed;
+
+	static int pid()
+	{
+#if _WINDOWS
+		return _getpid();
+#else
+		return getpid();
+#endif
+	}
+};
+
+#endif
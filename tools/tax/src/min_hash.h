@@ -0,0 +1,176 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#ifndef MIN_HASH_H_INCLUDED
+#define MIN_HASH_H_INCLUDED
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <unordered_map>
+#include "omp_adapter.h"
+
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+#define MIN_HASH_TARGETS __attribute__((target_clones("avx2", "default")))
+#else
+#define MIN_HASH_TARGETS
+#endif
+
+// one min hash sketch per random xor mask: for every mask keeps the kmer with minimal hash ^ mask
+// hashes are stored by add() and checked against all masks in one pass by finish(), ties go to the earliest added kmer
+struct MinHash
+{
+	struct Best
+	{
+		uint64_t hash = UINT64_MAX;
+		hash_t kmer = 0;
+		Best() = default;
+		Best(uint64_t hash, hash_t kmer) : hash(hash), kmer(kmer){}
+	};
+
+	std::vector<Best> best;
+	std::vector<uint64_t> storage_hash; // memory fetch optimization
+	std::vector<hash_t> storage_kmer;
+
+	std::vector<uint64_t> xors;
+
+	MinHash(size_t count) : best(count), xors(count)
+	{
+		std::mt19937 rng;
+		rng.seed(0);
+		std::uniform_int_distribution<std::mt19937::result_type> dist(0, UINT32_MAX);
+		for (size_t i = 0; i < count; i++)
+			xors[i] = (uint64_t(dist(rng)) << 32) | dist(rng);
+
+		storage_hash.reserve(10000000); // todo: think. filesize ?
+		storage_kmer.reserve(10000000); // todo: think. filesize ?
+	}
+
+	void add(uint64_t hash, hash_t kmer)
+	{
+		storage_hash.push_back(hash);
+		storage_kmer.push_back(kmer);
+	}
+
+	void finish()
+	{
+		// minima are kept with the sign bit flipped, so that signed comparison gives the unsigned order
+		auto mask_count = padded(best.size());
+		std::vector<int64_t> masks(mask_count, 0), minima(mask_count, INT64_MAX);
+		for (size_t i = 0; i < best.size(); i++)
+		{
+			masks[i] = flipped(xors[i]);
+			minima[i] = flipped(best[i].hash);
+		}
+
+		const size_t STRIPE = 1 << 14;
+		#pragma omp parallel
+		{
+			auto thread_minima = minima;
+			#pragma omp for schedule(static)
+			for (size_t from = 0; from < storage_hash.size(); from += STRIPE)
+				update_minima(&storage_hash[from], std::min(STRIPE, storage_hash.size() - from), masks.data(), thread_minima.data(), mask_count);
+
+			#pragma omp critical
+			for (size_t i = 0; i < mask_count; i++)
+				minima[i] = std::min(minima[i], thread_minima[i]);
+		}
+
+		// second pass finds kmers of the improved minima, first occurrence wins like in a sequential scan
+		std::unordered_map<uint64_t, std::pair<bool, hash_t>> kmers; // hash -> (found, kmer)
+		for (size_t i = 0; i < best.size(); i++)
+			if (unflipped(minima[i]) < best[i].hash)
+				kmers[unflipped(minima[i]) ^ xors[i]] = std::make_pair(false, hash_t(0));
+
+		size_t to_find = kmers.size();
+		for (size_t i = 0; i < storage_hash.size() && to_find > 0; i++)
+		{
+			auto it = kmers.find(storage_hash[i]);
+			if (it != kmers.end() && !it->second.first)
+			{
+				it->second = std::make_pair(true, storage_kmer[i]);
+				to_find--;
+			}
+		}
+
+		for (size_t i = 0; i < best.size(); i++)
+		{
+			auto hash = unflipped(minima[i]);
+			if (hash < best[i].hash)
+				best[i] = Best(hash, kmers[hash ^ xors[i]].second);
+		}
+
+		storage_hash.clear();
+		storage_kmer.clear();
+	}
+
+private:
+	static const uint64_t SIGN_BIT = 1ull << 63;
+	static const size_t LANES = 4; // masks per vector
+	static const size_t GROUP = 4; // vectors updated together
+
+	static size_t padded(size_t count) { return (count + LANES * GROUP - 1) / (LANES * GROUP) * LANES * GROUP; }
+	static int64_t flipped(uint64_t x) { return int64_t(x ^ SIGN_BIT); }
+	static uint64_t unflipped(int64_t x) { return uint64_t(x) ^ SIGN_BIT; }
+
+	// minima[m] = min(minima[m], hash ^ masks[m]) for all hashes, mask_count is a multiple of LANES * GROUP
+	// a tile of hashes is checked against a vector of masks at a time, so minima stay in registers
+	MIN_HASH_TARGETS
+	static void update_minima(const uint64_t *hashes, size_t count, const int64_t *masks, int64_t *minima, size_t mask_count)
+	{
+		const size_t TILE = 32;
+		for (size_t from = 0; from < count; from += TILE)
+		{
+			auto tile = std::min(TILE, count - from);
+#if defined(__GNUC__)
+			typedef int64_t Lanes __attribute__((vector_size(LANES * sizeof(int64_t))));
+			for (size_t m = 0; m < mask_count; m += LANES * GROUP)
+			{
+				Lanes mask[GROUP], minimum[GROUP];
+				memcpy(mask, masks + m, sizeof(mask));
+				memcpy(minimum, minima + m, sizeof(minimum));
+				for (size_t i = 0; i < tile; i++)
+					for (size_t g = 0; g < GROUP; g++) // independent vectors hide comparison latency
+					{
+						Lanes h = mask[g] ^ int64_t(hashes[from + i]);
+						Lanes less = h < minimum[g];
+						minimum[g] = (h & less) | (minimum[g] & ~less);
+					}
+
+				memcpy(minima + m, minimum, sizeof(minimum));
+			}
+#else
+			for (size_t m = 0; m < mask_count; m++)
+				for (size_t i = 0; i < tile; i++)
+					minima[m] = std::min(minima[m], masks[m] ^ int64_t(hashes[from + i]));
+#endif
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,339 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#ifndef MISMATCH_INDEX_H_INCLUDED
+#define MISMATCH_INDEX_H_INCLUDED
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <fstream>
+#include <stdexcept>
+#include <bitset>
+#include <cstdio>
+#include <cstring>
+#include "dbs.h"
+#include "kmer_search.h"
+#include "kway_merge.h"
+#include "seq_transform.h"
+
+// finds db kmers within max_mismatches letter substitutions of a query (pigeonhole):
+// kmers are cut into blocks, two kmers with at most max_mismatches substitutions share at least blocks - max_mismatches whole blocks
+// for every choice of shared blocks there is a copy of the db with those blocks moved to the top bits, sorted
+// a query looks up its shared blocks in every copy and compares the candidates letter by letter
+struct MismatchIndex
+{
+	static const int MAX_MISMATCHES = 3;
+
+	struct Entry : public DBS::KmerTax // kmer is permuted
+	{
+		Entry(hash_t kmer = 0, int tax_id = 0) : DBS::KmerTax(kmer, tax_id) {}
+		bool operator < (const Entry &x) const { return kmer < x.kmer; }
+	};
+
+	typedef KmerSearch<Entry, hash_t> Search;
+
+	MismatchIndex(int kmer_len, int max_mismatches) : kmer_len(kmer_len), max_mismatches(max_mismatches)
+	{
+		if (max_mismatches < 1 || max_mismatches > MAX_MISMATCHES)
+			throw std::runtime_error("mismatches should be 1 to " + std::to_string(MAX_MISMATCHES));
+
+		if (kmer_len < 4 * (max_mismatches + 2) || kmer_len * 2 > int(sizeof(hash_t) * 8))
+			throw std::runtime_error("kmer len " + std::to_string(kmer_len) + " is not supported with mismatches");
+
+		// 1 mismatch: 2 halves, 1 must match. more: max_mismatches + 2 blocks, 2 must match
+		int blocks = max_mismatches == 1 ? 2 : max_mismatches + 2;
+		for (int b = 0; b < blocks; b++)
+			block_letters.push_back(kmer_len * (b + 1) / blocks - kmer_len * b / blocks);
+
+		choose_shared(blocks - max_mismatches, 0, std::vector<int>());
+	}
+
+	size_t copies() const { return layouts.size(); }
+
+	template <class C>
+	void build(const C *kmers, size_t count)
+	{
+		source = SourceId::of(kmers, count);
+		tables.resize(copies());
+		for (size_t copy = 0; copy < copies(); copy++)
+		{
+			std::vector<Entry> permuted(count);
+			#pragma omp parallel for
+			for (size_t i = 0; i < count; i++)
+				permuted[i] = Entry(permute(kmers[i].kmer, copy), kmers[i].tax_id);
+
+			parallel_sort(permuted);
+			tables[copy].assign(std::move(permuted));
+		}
+
+		build_search();
+	}
+
+	// copies are stored as .dbs files next to the db
+	std::string copy_filename(const std::string &dbs, size_t copy) const
+	{
+		return dbs + ".mm" + std::to_string(max_mismatches) + "_" + std::to_string(copy);
+	}
+
+	// every copy ends with the identity of the db it was built from
+	void save(const std::string &dbs) const
+	{
+		for (size_t copy = 0; copy < copies(); copy++)
+		{
+			auto filename = copy_filename(dbs, copy);
+			DBSIO::save_dbs(filename + ".tmp", tables[copy].begin(), tables[copy].size(), kmer_len);
+			{
+				std::ofstream f(filename + ".tmp", std::ios::binary | std::ios::app);
+				IO::write(f, source);
+			}
+
+			if (std::rename((filename + ".tmp").c_str(), filename.c_str()) != 0)
+				throw std::runtime_error("cannot rename " + filename + ".tmp");
+		}
+	}
+
+	// false if some copy is missing, damaged or built from other kmers than db ones
+	template <class C>
+	bool load(const std::string &dbs, const C *db_kmers, size_t db_count)
+	{
+		auto db_source = SourceId::of(db_kmers, db_count);
+		std::vector<DBSArray<Entry>> loaded(copies());
+		for (size_t copy = 0; copy < copies(); copy++)
+		{
+			auto filename = copy_filename(dbs, copy);
+			if (!std::ifstream(filename).good())
+				return false;
+
+			try
+			{
+				if (!(SourceId::saved_in(filename) == db_source))
+				{
+					LOG("mismatch index " << filename << " was built from another db");
+					return false;
+				}
+
+				if (DBSIO::load_dbs(filename, loaded[copy]) != size_t(kmer_len) || loaded[copy].size() != db_count)
+				{
+					LOG("mismatch index " << filename << " does not match db");
+					return false;
+				}
+			}
+			catch (std::exception &e)
+			{
+				LOG("mismatch index " << filename << " is damaged: " << e.what());
+				return false;
+			}
+		}
+
+		tables.swap(loaded);
+		source = db_source;
+		build_search();
+		return true;
+	}
+
+	// tax of the closest db kmer to canonical kmer or its reverse complement, 0 if none within max_mismatches
+	// ties are resolved to lower tax id
+	int find(hash_t kmer) const
+	{
+		// all lookups are started before the first one is resolved
+		const size_t MAX_LOOKUPS = 2 * 10; // strands x copies for 3 mismatches
+		hash_t queries[MAX_LOOKUPS];
+		std::pair<const Entry*, const Entry*> ranges[MAX_LOOKUPS];
+		hash_t strands[2] = { kmer, seq_transform<hash_t>::to_rev_complement(kmer, kmer_len) };
+		size_t lookups = 0;
+		assert(copies() * 2 <= MAX_LOOKUPS);
+		for (size_t copy = 0; copy < copies(); copy++)
+			for (auto strand : strands)
+			{
+				queries[lookups] = permute(strand, copy);
+				ranges[lookups] = searches[copy]->prefetch_bucket(queries[lookups] & ~layouts[copy].suffix_mask);
+				lookups++;
+			}
+
+		int best_mismatches = max_mismatches + 1, best_tax = 0;
+		for (size_t i = 0; i < lookups; i++)
+		{
+			auto suffix_mask = layouts[i / 2].suffix_mask;
+			auto prefix = queries[i] & ~suffix_mask;
+			auto end = searches[i / 2]->end();
+			for (auto it = Search::lower_bound_in(ranges[i], prefix); it != end && (it->kmer & ~suffix_mask) == prefix; it++)
+			{
+				auto mismatches = letter_mismatches(it->kmer, queries[i]);
+				if (mismatches < best_mismatches || (mismatches == best_mismatches && it->tax_id < best_tax))
+				{
+					best_mismatches = mismatches;
+					best_tax = it->tax_id;
+				}
+			}
+		}
+
+		return best_tax;
+	}
+
+	static int letter_mismatches(hash_t a, hash_t b)
+	{
+		auto x = a ^ b;
+		return int(std::bitset<64>(uint64_t((x | (x >> 1)) & hash_t(0x5555555555555555ull))).count());
+	}
+
+private:
+	// kmer count and hash of the db contents
+	struct SourceId
+	{
+		static const uint64_t MAGIC = 0x44494352554f534dull; // "MSOURCID"
+		uint64_t magic, count, hash;
+
+		bool operator == (const SourceId &x) const
+		{
+			return magic == x.magic && count == x.count && hash == x.hash;
+		}
+
+		// blocks are hashed in parallel, then combined in order, so the result does not depend on threads
+		template <class C>
+		static SourceId of(const C *kmers, size_t count)
+		{
+			const size_t BLOCK = 1 << 16;
+			std::vector<uint64_t> block_hashes((count + BLOCK - 1) / BLOCK);
+			#pragma omp parallel for
+			for (size_t block = 0; block < block_hashes.size(); block++)
+			{
+				uint64_t h = 14695981039346656037ull;
+				for (size_t i = block * BLOCK; i < std::min(count, (block + 1) * BLOCK); i++)
+					h = mix(h ^ uint64_t(kmers[i].kmer) ^ (uint64_t(uint32_t(kmers[i].tax_id)) << 17));
+
+				block_hashes[block] = h;
+			}
+
+			SourceId id;
+			id.magic = MAGIC;
+			id.count = count;
+			id.hash = 0;
+			for (auto h : block_hashes)
+				id.hash = mix(id.hash ^ h);
+
+			return id;
+		}
+
+		// copies saved before the identity was added have none
+		static SourceId saved_in(const std::string &filename)
+		{
+			SourceId id;
+			memset(&id, 0, sizeof(id));
+			std::ifstream f(filename, std::ios::binary | std::ios::in);
+			f.seekg(0, std::ios::end);
+			if (f && size_t(f.tellg()) >= sizeof(id))
+			{
+				f.seekg(-std::streamoff(sizeof(id)), std::ios::end);
+				IO::read(f, id);
+			}
+
+			return id;
+		}
+
+		static uint64_t mix(uint64_t x) // murmur3 finalizer
+		{
+			x ^= x >> 33;
+			x *= 0xff51afd7ed558ccdull;
+			x ^= x >> 33;
+			x *= 0xc4ceb93fe53a8d63ull;
+			return x ^ (x >> 33);
+		}
+	};
+
+	SourceId source;
+
+	struct Block
+	{
+		int shift, letters;
+	};
+
+	struct Layout
+	{
+		std::vector<Block> blocks; // shared blocks first
+		hash_t suffix_mask; // bits of blocks which are not shared
+	};
+
+	int kmer_len, max_mismatches;
+	std::vector<int> block_letters;
+	std::vector<Layout> layouts;
+	std::vector<DBSArray<Entry>> tables;
+	std::vector<std::unique_ptr<Search>> searches;
+
+	void choose_shared(int left, int from, std::vector<int> shared)
+	{
+		if (left == 0)
+		{
+			add_layout(shared);
+			return;
+		}
+
+		for (int b = from; b < int(block_letters.size()); b++)
+		{
+			shared.push_back(b);
+			choose_shared(left - 1, b + 1, shared);
+			shared.pop_back();
+		}
+	}
+
+	void add_layout(const std::vector<int> &shared)
+	{
+		Layout layout;
+		int suffix_letters = 0;
+		for (int pass = 0; pass < 2; pass++) // shared blocks, then the rest
+			for (int b = 0, start = 0; b < int(block_letters.size()); start += block_letters[b], b++)
+			{
+				bool is_shared = std::find(shared.begin(), shared.end(), b) != shared.end();
+				if (is_shared != (pass == 0))
+					continue;
+
+				layout.blocks.push_back(Block{2 * (kmer_len - start - block_letters[b]), block_letters[b]});
+				if (!is_shared)
+					suffix_letters += block_letters[b];
+			}
+
+		layout.suffix_mask = (hash_t(1) << (2 * suffix_letters)) - 1;
+		layouts.push_back(layout);
+	}
+
+	hash_t permute(hash_t kmer, size_t copy) const
+	{
+		hash_t permuted = 0;
+		for (auto &block : layouts[copy].blocks)
+			permuted = (permuted << (2 * block.letters)) | ((kmer >> block.shift) & ((hash_t(1) << (2 * block.letters)) - 1));
+
+		return permuted;
+	}
+
+	void build_search()
+	{
+		searches.clear();
+		for (auto &table : tables)
+			searches.emplace_back(new Search(table.begin(), table.size(), kmer_len));
+	}
+};
+
+#endif
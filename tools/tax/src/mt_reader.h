@@ -30,24 +30,21 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <deque>
+#include <exception>
+#include <type_traits>
 
-#include "log.h"
-
+// each fragment is decoded exactly once: seekable readers are split into parts, one part per thread,
+// other readers are decoded by single thread, in both cases chunks go to consumer through shared queue
 template <typename ReaderType>
 class MTReader final: public Reader {
 private:
-    typedef std::vector<Fragment> Chunk;
     struct Thread {
         // protected with global reader locked
         bool done;
         float progress;
-        size_t next_chunk_idx;
-        bool chunk_ready;
-        Chunk loaded_chunk;
-        std::condition_variable consumed;
 
         // private to thread
-        size_t chunk_idx;
         ReaderType reader;
         std::thread thread_impl;
 
@@ -55,132 +52,127 @@ private:
         Thread(Args... args)
             : done(false)
             , progress(0)
-            , chunk_ready(false)
-            , chunk_idx(0)
             , reader(args...)
         {}
         Thread(Thread&& other) = delete;
         Thread(const Thread& other) = delete;
+    };
+    const size_t chunk_size;
+    const size_t max_queued_chunks;
+    bool all_done;
+    bool stopping;
+    std::exception_ptr error;
+    std::vector<std::unique_ptr<Thread> > threads;
+    mutable std::mutex mutex;
+    std::condition_variable ready; // chunk is queued or thread is done
+    std::condition_variable consumed; // chunk is taken from queue
+    std::deque<Chunk> queue;
+    std::vector<Chunk> free_chunks; // consumed chunks, reused to keep their buffers
 
-        void run(size_t chunk_size, size_t start_chunk_idx, std::mutex& mutex, std::condition_variable& ready) {
-            try {
-                run_impl(chunk_size, start_chunk_idx, mutex, ready);
-            } catch (ngs::ErrorMsg error) {
-                LOG("Exception in reader thread: " << error.what());
-                std::terminate();
-            }
-        }
+    Chunk current_chunk;
+    size_t current_fragment_idx;
 
-        void run_impl(size_t chunk_size, size_t start_chunk_idx, std::mutex& mutex, std::condition_variable& ready) {
-            size_t skip_to_idx = start_chunk_idx;
+    void run(Thread& thread) {
+        std::exception_ptr thread_error;
+        try {
             Chunk chunk;
-            std::unique_lock<std::mutex> lock(mutex);
-            while (!done) {
-                float chunk_progress = progress;
-                lock.unlock();
-                { // not locked section
-                    assert(chunk_idx <= skip_to_idx);
-                    size_t fragments_to_skip = (skip_to_idx - chunk_idx) * chunk_size;
-                    for (size_t i = 0; i < fragments_to_skip; ++i) {
-                        if (!reader.read(nullptr)) {
-                            break;
-                        }
-                    }
+            bool eof = false;
+            while (!eof) {
+                eof = !thread.reader.read_chunk(chunk, chunk_size);
+                const float chunk_progress = thread.reader.progress();
 
-                    chunk.resize(chunk_size);
-                    for (size_t i = 0; i < chunk_size; ++i) {
-                        if (!reader.read(&chunk[i])) {
-                            chunk.resize(i);
-                            break;
-                        }
-                    }
-                    chunk_idx = skip_to_idx + 1;
-                    
-                    chunk_progress = reader.progress();
+                std::unique_lock<std::mutex> lock(mutex);
+                while (!chunk.empty() && queue.size() >= max_queued_chunks && !stopping) {
+                    consumed.wait(lock);
+                }
+                if (stopping) {
+                    break;
                 }
-                lock.lock();
-                const bool reader_at_eof = chunk.size() < chunk_size;
                 if (!chunk.empty()) {
-                    while (chunk_ready) {
-                        consumed.wait(lock);
+                    queue.emplace_back();
+                    std::swap(queue.back(), chunk);
+                    if (!free_chunks.empty()) {
+                        std::swap(chunk, free_chunks.back());
+                        free_chunks.pop_back();
                     }
-                    std::swap(loaded_chunk, chunk);
-                    chunk_ready = true;
-                    skip_to_idx = next_chunk_idx;
                 }
-                progress = chunk_progress; 
-                done = reader_at_eof;
+                thread.progress = chunk_progress;
                 ready.notify_one();
             }
+        } catch (...) {
+            thread_error = std::current_exception();
         }
-    };
-    const size_t chunk_size;
-    bool all_done;
-    size_t next_chunk_idx;
-    std::vector<std::unique_ptr<Thread> > threads;
-    mutable std::mutex mutex;
-    std::condition_variable ready;
-    
-    Chunk current_chunk;
-    size_t current_fragment_idx;
 
-    
+        std::unique_lock<std::mutex> lock(mutex);
+        if (thread_error && !error) {
+            error = thread_error;
+        }
+        thread.done = true;
+        ready.notify_one();
+    }
+
+    template <typename ...Args>
+    void create_threads(std::true_type /*seekable*/, size_t thread_count, Args... args) {
+        threads.resize(thread_count);
+
+        #pragma omp parallel for
+        for (size_t i = 0; i < thread_count; ++i) {
+            threads[i] = std::unique_ptr<Thread>(new Thread(Part(i, thread_count), args...));
+        }
+    }
+
+    template <typename ...Args>
+    void create_threads(std::false_type /*seekable*/, size_t /*thread_count*/, Args... args) {
+        threads.push_back(std::unique_ptr<Thread>(new Thread(args...)));
+    }
+
     bool load_chunk() {
-        while (!all_done) {
-            std::unique_lock<std::mutex> lock(mutex);
-            size_t done_count = 0;
-            for (auto& thread: threads) {
-                if (thread->chunk_ready) {
-                    current_fragment_idx = 0;
-                    std::swap(current_chunk, thread->loaded_chunk);
-                    thread->next_chunk_idx = next_chunk_idx;
-                    ++next_chunk_idx;
-                    thread->chunk_ready = false;
-                    thread->consumed.notify_one();
-                    return true;
-                }
-                if (thread->done) {
-                    ++done_count;
-                }
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            if (error) {
+                std::rethrow_exception(error);
             }
-            all_done = (done_count == threads.size());
-            if (!all_done) {
-                ready.wait(lock);
+            if (!queue.empty()) {
+                break;
             }
+            all_done = std::all_of(threads.begin(), threads.end(), [](const std::unique_ptr<Thread>& thread) { return thread->done; });
+            if (all_done) {
+                return false;
+            }
+            ready.wait(lock);
+        }
+
+        if (current_chunk.data.capacity()) {
+            free_chunks.emplace_back();
+            std::swap(free_chunks.back(), current_chunk);
         }
-        return false;
+        std::swap(current_chunk, queue.front());
+        queue.pop_front();
+        current_fragment_idx = 0;
+        consumed.notify_one();
+        return true;
     }
     
 public:
     template <typename ...Args>
     MTReader(size_t thread_count, size_t chunk_size, Args... args)
         : chunk_size(chunk_size)
+        , max_queued_chunks(thread_count * 2)
         , all_done(false)
+        , stopping(false)
         , current_fragment_idx(0)
     {
         assert(thread_count > 0);
-        threads.resize(thread_count);
+        create_threads(std::integral_constant<bool, ReaderType::SEEKABLE>(), thread_count, args...);
 
-        #pragma omp parallel for
-        for (auto i = 0; i < thread_count; ++i) {
-            threads[i] = std::unique_ptr<Thread>(new Thread(args...));
-        }
-        
-        for (size_t i = 0; i < thread_count; ++i) {
-            auto& thread = threads[i];
-            const size_t start_chunk_idx = i;
-            thread->next_chunk_idx = start_chunk_idx + thread_count;
-            thread->thread_impl = std::thread(&MTReader::Thread::run, thread.get(), chunk_size, start_chunk_idx, std::ref(mutex), std::ref(ready));
+        for (auto& thread: threads) {
+            thread->thread_impl = std::thread(&MTReader::run, this, std::ref(*thread));
         }
-        next_chunk_idx = thread_count * 2;
     }
     ~MTReader() {
         std::unique_lock<std::mutex> lock(mutex);
-        for (auto& thread: threads) {
-            thread->done = true;
-            thread->chunk_ready = false;
-            thread->consumed.notify_one();
-        }
+        stopping = true;
+        consumed.notify_all();
         lock.unlock();
         for (auto& thread: threads) {
             thread->thread_impl.join();
@@ -193,11 +185,11 @@ public:
     }
     float progress() const override {
         std::unique_lock<std::mutex> lock(mutex);
-        float max_progress = 0;
+        float sum_progress = 0; // parts are of the same size
         for (auto& thread : threads) {
-            max_progress = std::max(max_progress, thread->progress);
+            sum_progress += thread->progress;
         }
-        return max_progress;
+        return sum_progress / threads.size();
     }
 
     bool read(Fragment* output) override {
@@ -208,13 +200,28 @@ public:
         }
         assert(current_fragment_idx < current_chunk.size());
         if (output) {
-            std::swap(*output, current_chunk[current_fragment_idx]);
+            current_chunk.get(current_fragment_idx, output);
         }
         ++current_fragment_idx;
         return true;
     }
 
     bool read_many(std::vector<Fragment>& output) override {
+        if (current_fragment_idx >= current_chunk.size()) {
+            if (!load_chunk()) {
+                output.clear();
+                return false;
+            }
+        }
+        output.resize(current_chunk.size() - current_fragment_idx);
+        for (auto& fragment: output) {
+            current_chunk.get(current_fragment_idx++, &fragment);
+        }
+        assert(!output.empty());
+        return true;
+    }
+
+    bool read_chunk(Chunk& output, size_t /*max_count*/) override {
         if (current_fragment_idx >= current_chunk.size()) {
             if (!load_chunk()) {
                 output.clear();
@@ -223,15 +230,16 @@ public:
         }
         if (current_fragment_idx == 0) {
             std::swap(current_chunk, output);
-            current_fragment_idx = current_chunk.size();
+            current_chunk.clear();
         } else {
-            size_t count = current_chunk.size() - current_fragment_idx;
-            output.resize(count);
-            for (size_t i = 0; i < count; ++i) {
-                std::swap(output[i], current_chunk[i + current_fragment_idx]);
+            output.clear();
+            Fragment fragment;
+            for (; current_fragment_idx < current_chunk.size(); ++current_fragment_idx) {
+                current_chunk.get(current_fragment_idx, &fragment);
+                output.add(fragment);
             }
-            current_fragment_idx += count;
         }
+        current_fragment_idx = current_chunk.size();
         assert(!output.empty());
         return true;
     }
@@ -32,4 +32,7 @@
    inline int omp_get_max_threads() { return 0; }
    inline int omp_get_thread_num() { return 0; }
    inline int omp_get_num_threads() { return 1; }
+   inline void omp_set_num_threads(int) {}
+   inline void omp_set_max_active_levels(int) {}
+   inline int omp_in_parallel() { return 0; }
 #endif
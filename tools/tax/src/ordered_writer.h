@@ -0,0 +1,150 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#ifndef ORDERED_WRITER_H_INCLUDED
+#define ORDERED_WRITER_H_INCLUDED
+
+#include <string>
+#include <map>
+#include <ostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+#include <algorithm>
+
+// single writer thread, emits text chunks in the order of their sequence numbers
+// put() of a chunk far ahead of the next expected one waits while too many chunks are pending
+class OrderedWriter
+{
+	std::ostream &out_f;
+	const size_t max_pending;
+	std::map<size_t, std::string> pending;
+	size_t next_seq;
+	bool finished, aborted;
+	std::string error; // set by writer thread, reported by finish()
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::thread writer;
+
+public:
+	OrderedWriter(std::ostream &out_f, size_t max_pending) : 
+		out_f(out_f), 
+		max_pending(std::max(max_pending, size_t(1))), 
+		next_seq(0), 
+		finished(false),
+		aborted(false)
+	{
+		writer = std::thread(&OrderedWriter::write_all, this);
+	}
+
+	~OrderedWriter()
+	{
+		stop();
+	}
+
+	void put(size_t seq, std::string &&text)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [&]() { return aborted || seq == next_seq || pending.size() < max_pending; });
+		if (aborted)
+			return;
+
+		pending[seq] = std::move(text);
+		changed.notify_all();
+	}
+
+	// waits until everything put is written, throws if some chunk was never put
+	void finish()
+	{
+		stop();
+		if (!error.empty())
+			throw std::runtime_error(error);
+	}
+
+	// on error of a producer: stops writing, waiting and later chunks are dropped
+	void abort()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			aborted = true;
+			changed.notify_all();
+		}
+
+		stop();
+	}
+
+private:
+	void stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (finished)
+				return;
+
+			finished = true;
+			changed.notify_all();
+		}
+
+		writer.join();
+		out_f.flush();
+	}
+
+	void write_all()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true)
+		{
+			changed.wait(lock, [&]() { return finished || aborted || has_next(); });
+			if (aborted)
+				return;
+
+			if (!has_next())
+			{
+				if (!pending.empty())
+					error = "ordered writer: missing chunk " + std::to_string(next_seq);
+
+				return;
+			}
+
+			std::string text = std::move(pending.begin()->second);
+			pending.erase(pending.begin());
+			next_seq++;
+			changed.notify_all();
+
+			lock.unlock();
+			out_f << text;
+			lock.lock();
+		}
+	}
+
+	bool has_next() const
+	{
+		return !pending.empty() && pending.begin()->first == next_seq;
+	}
+};
+
+#endif
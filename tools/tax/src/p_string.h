@@ -27,6 +27,8 @@
 #ifndef P_STRING_H_INCLUDED
 #define P_STRING_H_INCLUDED
 
+#include <ostream>
+
 struct p_string
 {
 	const char *s;
@@ -55,4 +57,9 @@ struct p_string
 	}
 };
 
+inline std::ostream &operator << (std::ostream &out, const p_string &s)
+{
+	return out.write(s.s, s.len);
+}
+
 #endif
\ No newline at end of file
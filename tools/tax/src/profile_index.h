@@ -0,0 +1,246 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#ifndef PROFILE_INDEX_H_INCLUDED
+#define PROFILE_INDEX_H_INCLUDED
+
+#include "io.h"
+#include "mapped_file.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <stdexcept>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "omp_adapter.h"
+
+// locality sensitive hashing over min hash profiles of the same length
+// profile is cut into bands of consecutive kmers, profiles with all kmers of a band equal are candidates of each other
+// profiles with similarity s share a band with probability 1 - (1 - s^rows)^bands
+// file is mapped: header, then band keys sorted within every band, then profile numbers in the same order
+struct ProfileIndex
+{
+	static const size_t MAGIC = 0x58444e4946525000ull; // "\0PRFINDX"
+	static const size_t VERSION = 2;
+	static const size_t DATA_ALIGNMENT = 4096;
+	static const size_t DEFAULT_BANDS = 64;
+	static const size_t DEFAULT_ROWS = 3;
+
+	struct Header
+	{
+		size_t magic, version;
+		size_t profile_count, profile_len, bands, rows;
+		size_t source_hash; // of profile file names, sizes and modification times, catches index built for another list or older profiles
+		size_t keys_offset, ids_offset, reserved, checksum;
+
+		Header(size_t profile_count = 0, size_t profile_len = 0, size_t bands = 0, size_t rows = 0, size_t source_hash = 0) :
+			magic(MAGIC), version(VERSION), profile_count(profile_count), profile_len(profile_len), bands(bands), rows(rows), source_hash(source_hash), reserved(0)
+		{
+			keys_offset = DATA_ALIGNMENT;
+			ids_offset = keys_offset + bands * profile_count * sizeof(uint64_t);
+			checksum = MappedHeader::checksum(*this);
+		}
+	};
+
+	// profile names, then name, size and modification time of every file the profiles are read from
+	// (the profiles themselves or the store holding them), so that regenerated profiles get a new index
+	static uint64_t source_hash(const std::vector<std::string> &filenames, const std::vector<std::string> &source_files)
+	{
+		uint64_t h = 14695981039346656037UL;
+		auto add = [&](const std::string &s)
+		{
+			for (auto ch : s + '\n')
+				h = (h ^ (unsigned char)ch) * 1099511628211;
+		};
+
+		for (auto &filename : filenames)
+			add(filename);
+
+		for (auto &filename : source_files)
+		{
+			struct stat st;
+			if (stat(filename.c_str(), &st) != 0)
+				throw std::runtime_error(std::string("cannot stat file ") + filename);
+
+			add(filename);
+			add(std::to_string(uint64_t(st.st_size)) + ' ' + std::to_string(int64_t(st.st_mtime)));
+		}
+
+		return h;
+	}
+
+	// false for missing, damaged or other version index too, all of them are rebuilt
+	static bool is_current(const std::string &filename, size_t profile_count, uint64_t source_hash)
+	{
+		try
+		{
+			return ProfileIndex(filename).matches(profile_count, source_hash);
+		}
+		catch (std::runtime_error &)
+		{
+			return false;
+		}
+	}
+
+	static uint64_t band_key(const hash_t *kmers, size_t band, size_t rows)
+	{
+		uint64_t h = 14695981039346656037UL;
+		for (size_t i = band * rows; i < (band + 1) * rows; i++)
+		{
+			h = (h ^ uint64_t(kmers[i])) * 1099511628211;
+			h ^= h >> 29;
+		}
+
+		return h;
+	}
+
+	// kmers_of(i, kmers) fills kmers of profile i, it is called once per profile from several threads
+	template <class KmersOf>
+	static void build(const std::string &filename, size_t profile_count, size_t profile_len, uint64_t source_hash, KmersOf &&kmers_of, size_t bands = DEFAULT_BANDS, size_t rows = DEFAULT_ROWS)
+	{
+		if (bands == 0 || rows == 0 || bands * rows > profile_len)
+			throw std::runtime_error("ProfileIndex:: profile is too short for bands * rows");
+
+		struct Entry
+		{
+			uint64_t key;
+			uint32_t id;
+			bool operator < (const Entry &x) const { return key < x.key || (key == x.key && id < x.id); }
+		};
+
+		if (profile_count > UINT32_MAX)
+			throw std::runtime_error("ProfileIndex:: too many profiles");
+
+		std::vector<Entry> entries(bands * profile_count);
+		std::exception_ptr error; // first error of worker threads
+		#pragma omp parallel
+		{
+			std::vector<hash_t> kmers;
+			#pragma omp for schedule(dynamic, 64)
+			for (size_t i = 0; i < profile_count; i++)
+			{
+				try
+				{
+					kmers_of(i, kmers);
+					if (kmers.size() != profile_len)
+						throw std::runtime_error("ProfileIndex:: profiles have different length");
+				}
+				catch (...)
+				{
+					#pragma omp critical
+					if (!error)
+						error = std::current_exception();
+					continue;
+				}
+
+				for (size_t band = 0; band < bands; band++)
+					entries[band * profile_count + i] = Entry{band_key(kmers.data(), band, rows), uint32_t(i)};
+			}
+		}
+
+		if (error)
+			std::rethrow_exception(error);
+
+		#pragma omp parallel for schedule(dynamic, 1)
+		for (size_t band = 0; band < bands; band++)
+			std::sort(entries.begin() + band * profile_count, entries.begin() + (band + 1) * profile_count);
+
+		ReplacingFile file(filename); // index may be mapped by other processes
+		auto &f = file.stream();
+		Header header(profile_count, profile_len, bands, rows, source_hash);
+		IO::write(f, header);
+		std::vector<char> padding(header.keys_offset - sizeof(header));
+		IO::save_vector_data(f, padding);
+
+		std::vector<uint64_t> keys(profile_count);
+		std::vector<uint32_t> ids(profile_count);
+		for (size_t band = 0; band < bands; band++)
+		{
+			for (size_t i = 0; i < profile_count; i++)
+				keys[i] = entries[band * profile_count + i].key;
+			f.write((const char*)keys.data(), keys.size() * sizeof(uint64_t));
+		}
+
+		for (size_t band = 0; band < bands; band++)
+		{
+			for (size_t i = 0; i < profile_count; i++)
+				ids[i] = entries[band * profile_count + i].id;
+			f.write((const char*)ids.data(), ids.size() * sizeof(uint32_t));
+		}
+
+		if (!f)
+			throw std::runtime_error(std::string("cannot save profile index ") + filename);
+
+		file.commit();
+	}
+
+	ProfileIndex(const std::string &filename) : file(new MappedFile(filename))
+	{
+		header = MappedHeader::read<Header>(*file, MAGIC, VERSION, "profile index", filename);
+		if (file->size() < header.ids_offset + header.bands * header.profile_count * sizeof(uint32_t))
+			throw std::runtime_error(std::string("profile index is truncated ") + filename);
+
+		keys = (const uint64_t*)(file->data() + header.keys_offset);
+		ids = (const uint32_t*)(file->data() + header.ids_offset);
+	}
+
+	size_t profile_count() const { return header.profile_count; }
+	size_t profile_len() const { return header.profile_len; }
+	bool matches(size_t profile_count, uint64_t source_hash) const { return profile_count == header.profile_count && source_hash == header.source_hash; }
+
+	// numbers of profiles sharing at least one band with kmers, in increasing order
+	std::vector<uint32_t> candidates(const std::vector<hash_t> &kmers) const
+	{
+		if (kmers.size() != header.profile_len)
+			throw std::runtime_error("ProfileIndex:: profile length differs from the index");
+
+		std::vector<uint32_t> found;
+		for (size_t band = 0; band < header.bands; band++)
+		{
+			auto first = keys + band * header.profile_count;
+			auto last = first + header.profile_count;
+			auto range = std::equal_range(first, last, band_key(kmers.data(), band, header.rows));
+			for (auto it = range.first; it != range.second; ++it)
+				found.push_back(ids[it - keys]);
+		}
+
+		std::sort(found.begin(), found.end());
+		found.erase(std::unique(found.begin(), found.end()), found.end());
+		return found;
+	}
+
+private:
+	std::unique_ptr<MappedFile> file;
+	Header header;
+	const uint64_t *keys;
+	const uint32_t *ids;
+};
+
+#endif
@@ -0,0 +1,132 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#ifndef PROFILE_SIMILARITY_H_INCLUDED
+#define PROFILE_SIMILARITY_H_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PROFILE_SIMILARITY_X86 1
+#include <immintrin.h>
+#else
+#define PROFILE_SIMILARITY_X86 0
+#endif
+
+// share of positions where two min hash profiles have the same kmer
+// equal positions are counted by the widest vector kernel the cpu supports, chosen once at first use
+struct ProfileSimilarity
+{
+	typedef size_t (*CountEqual)(const uint64_t *a, const uint64_t *b, size_t len);
+
+	double operator() (const hash_t *a, const hash_t *b, size_t len) const
+	{
+		static_assert(sizeof(hash_t) == sizeof(uint64_t), "profile kmers are 64 bit");
+		if (len == 0)
+			throw std::runtime_error("ProfileSimilarity:: a.kmers.empty()");
+
+		return double(count_equal(a, b, len)) / len;
+	}
+
+	static size_t count_equal(const uint64_t *a, const uint64_t *b, size_t len)
+	{
+		static const CountEqual chosen = choose();
+		return chosen(a, b, len);
+	}
+
+	static const char *kernel_name()
+	{
+		auto chosen = choose();
+#if PROFILE_SIMILARITY_X86
+		if (chosen == count_equal_avx2)
+			return "avx2";
+		if (chosen == count_equal_sse42)
+			return "sse4.2";
+#endif
+		return chosen == count_equal_scalar ? "scalar" : "unknown";
+	}
+
+	static size_t count_equal_scalar(const uint64_t *a, const uint64_t *b, size_t len)
+	{
+		size_t sum = 0;
+		for (size_t i = 0; i < len; i++)
+			sum += a[i] == b[i];
+
+		return sum;
+	}
+
+#if PROFILE_SIMILARITY_X86
+	// equal lanes compare to -1, subtracting them counts per lane
+	__attribute__((target("sse4.2")))
+	static size_t count_equal_sse42(const uint64_t *a, const uint64_t *b, size_t len)
+	{
+		__m128i sum0 = _mm_setzero_si128(), sum1 = _mm_setzero_si128();
+		size_t i = 0;
+		for (; i + 4 <= len; i += 4)
+		{
+			sum0 = _mm_sub_epi64(sum0, _mm_cmpeq_epi64(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i))));
+			sum1 = _mm_sub_epi64(sum1, _mm_cmpeq_epi64(_mm_loadu_si128((const __m128i*)(a + i + 2)), _mm_loadu_si128((const __m128i*)(b + i + 2))));
+		}
+
+		uint64_t lanes[2];
+		_mm_storeu_si128((__m128i*)lanes, _mm_add_epi64(sum0, sum1));
+		return lanes[0] + lanes[1] + count_equal_scalar(a + i, b + i, len - i);
+	}
+
+	__attribute__((target("avx2")))
+	static size_t count_equal_avx2(const uint64_t *a, const uint64_t *b, size_t len)
+	{
+		__m256i sum0 = _mm256_setzero_si256(), sum1 = _mm256_setzero_si256();
+		size_t i = 0;
+		for (; i + 8 <= len; i += 8)
+		{
+			sum0 = _mm256_sub_epi64(sum0, _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*)(a + i)), _mm256_loadu_si256((const __m256i*)(b + i))));
+			sum1 = _mm256_sub_epi64(sum1, _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*)(a + i + 4)), _mm256_loadu_si256((const __m256i*)(b + i + 4))));
+		}
+
+		uint64_t lanes[4];
+		_mm256_storeu_si256((__m256i*)lanes, _mm256_add_epi64(sum0, sum1));
+		return lanes[0] + lanes[1] + lanes[2] + lanes[3] + count_equal_scalar(a + i, b + i, len - i);
+	}
+#endif
+
+private:
+	static CountEqual choose()
+	{
+#if PROFILE_SIMILARITY_X86
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return count_equal_avx2;
+		if (__builtin_cpu_supports("sse4.2"))
+			return count_equal_sse42;
+#endif
+		return count_equal_scalar;
+	}
+};
+
+#endif
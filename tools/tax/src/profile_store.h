@@ -0,0 +1,146 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#ifndef PROFILE_STORE_H_INCLUDED
+#define PROFILE_STORE_H_INCLUDED
+
+#include "io.h"
+#include "mapped_file.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <stdint.h>
+
+// min hash profiles of the same length with their file names, either loaded into memory or mapped from a .profiles file
+// file is a header, then kmers of all profiles one after another, then names each followed by '\n'
+struct ProfileStore
+{
+	static const size_t MAGIC = 0x524f545346525000ull; // "\0PRFSTOR"
+	static const size_t VERSION = 1;
+	static const size_t DATA_ALIGNMENT = 4096;
+
+	struct Header
+	{
+		size_t magic, version;
+		size_t profile_count, profile_len;
+		size_t kmers_offset, names_offset, names_size, reserved, checksum;
+
+		Header(size_t profile_count = 0, size_t profile_len = 0, size_t names_size = 0) :
+			magic(MAGIC), version(VERSION), profile_count(profile_count), profile_len(profile_len), names_size(names_size), reserved(0)
+		{
+			kmers_offset = DATA_ALIGNMENT;
+			names_offset = kmers_offset + profile_count * profile_len * sizeof(hash_t);
+			checksum = MappedHeader::checksum(*this);
+		}
+	};
+
+	static bool is_store(const std::string &filename)
+	{
+		const std::string EXTENSION = ".profiles";
+		return filename.size() >= EXTENSION.size() && filename.compare(filename.size() - EXTENSION.size(), EXTENSION.size(), EXTENSION) == 0;
+	}
+
+	ProfileStore() : len(0), first(nullptr) {}
+
+	ProfileStore(const std::string &filename) : file(new MappedFile(filename))
+	{
+		auto header = MappedHeader::read<Header>(*file, MAGIC, VERSION, "profile store", filename);
+		if (file->size() < header.names_offset + header.names_size)
+			throw std::runtime_error(std::string("profile store is truncated ") + filename);
+
+		len = header.profile_len;
+		first = (const hash_t*)(file->data() + header.kmers_offset);
+
+		auto p = file->data() + header.names_offset, end = p + header.names_size;
+		while (p < end)
+		{
+			auto eol = std::find(p, end, '\n');
+			names.push_back(std::string(p, eol));
+			p = eol + 1;
+		}
+
+		if (names.size() != header.profile_count)
+			throw std::runtime_error(std::string("profile store names are damaged ") + filename);
+	}
+
+	size_t size() const { return names.size(); }
+	size_t profile_len() const { return len; }
+	const hash_t *kmers(size_t i) const { return (file ? first : storage.data()) + i * len; }
+	const std::string &name(size_t i) const { return names[i]; }
+	const std::vector<std::string> &filenames() const { return names; }
+
+	// adds profile to memory, store must not be mapped
+	void add(const std::string &name, const std::vector<hash_t> &kmers)
+	{
+		if (file)
+			throw std::runtime_error("ProfileStore:: cannot add to mapped store");
+
+		if (names.empty())
+			len = kmers.size();
+		else if (kmers.size() != len)
+			throw std::runtime_error(std::string("profile length differs from previous ones ") + name);
+
+		if (name.find('\n') != std::string::npos)
+			throw std::runtime_error(std::string("bad profile name ") + name);
+
+		names.push_back(name);
+		storage.insert(storage.end(), kmers.begin(), kmers.end());
+	}
+
+	void save(const std::string &filename) const
+	{
+		std::string all_names;
+		for (auto &name : names)
+			all_names += name + '\n';
+
+		ReplacingFile file(filename); // store may be mapped by other processes
+		auto &f = file.stream();
+		Header header(size(), len, all_names.size());
+		IO::write(f, header);
+		std::vector<char> padding(header.kmers_offset - sizeof(header));
+		IO::save_vector_data(f, padding);
+		f.write((const char*)kmers(0), size() * len * sizeof(hash_t));
+		f.write(all_names.data(), all_names.size());
+
+		if (!f)
+			throw std::runtime_error(std::string("cannot save profile store ") + filename);
+
+		file.commit();
+	}
+
+private:
+	std::unique_ptr<MappedFile> file;
+	std::vector<hash_t> storage;
+	std::vector<std::string> names;
+	size_t len;
+	const hash_t *first;
+};
+
+#endif
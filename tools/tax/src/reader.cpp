@@ -26,6 +26,7 @@
 
 #include "reader.h"
 #include "fasta_reader.h"
+#include "fastq_reader.h"
 #include "vdb_reader.h"
 #include "mt_reader.h"
 #include "aux_reader.h"
@@ -69,7 +70,9 @@ static ReaderPtr create_threaded(const std::string& filter_file, bool exclude_fi
 
 ReaderPtr Reader::create(const std::string& path, const Reader::Params& params) {
     if (FastaReader::is_fasta(path)) {
-        return create_threaded<FastaReader>(params.filter_file, params.exclude_filter, params.split_non_atgc, params.thread_count, params.chunk_size, path);
+        return create_threaded<FastaReader>(params.filter_file, params.exclude_filter, params.split_non_atgc, params.thread_count, params.chunk_size, path, params.thread_count);
+    } else if (FastqReader::is_fastq(path)) {
+        return create_threaded<FastqReader>(params.filter_file, params.exclude_filter, params.split_non_atgc, params.thread_count, params.chunk_size, path, params.read_qualities, params.thread_count);
     } else {
         if (!params.unaligned_only && AlignedVdbReader::is_aligned(path)) {
             return create_threaded<AlignedVdbReader>(params.filter_file, params.exclude_filter, params.split_non_atgc, params.thread_count, params.chunk_size, path, params.read_qualities);
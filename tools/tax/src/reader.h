@@ -32,6 +32,8 @@
 #include <assert.h>
 #include <memory>
 #include <algorithm>
+#include <stdexcept>
+#include "p_string.h"
 
 class Reader;
 typedef std::unique_ptr<Reader> ReaderPtr;
@@ -69,6 +71,67 @@ public:
         };
     };
 
+    // fragments of a chunk in one buffer, each fragment keeps offsets of its spotid and bases
+    // buffers are reused by the next chunk, so reading does not allocate once the chunk is warmed up
+    struct Chunk
+    {
+        struct Entry
+        {
+            size_t spotid, bases; // offsets in data
+            int spotid_len, bases_len;
+        };
+
+        std::string data;
+        std::vector<Entry> entries; // fragments can share spotid and bases, e.g. after split
+
+        size_t size() const { return entries.size(); }
+        bool empty() const { return entries.empty(); }
+        void clear() {
+            data.clear();
+            entries.clear();
+        }
+
+        p_string spotid(size_t i) const { return p_string(data.data() + entries[i].spotid, entries[i].spotid_len); }
+        p_string bases(size_t i) const { return p_string(data.data() + entries[i].bases, entries[i].bases_len); }
+
+        // starts new fragment, its bases are appended afterwards
+        void start(const char* spotid, size_t spotid_len) {
+            Entry entry;
+            entry.spotid = data.size();
+            entry.spotid_len = int(spotid_len);
+            entry.bases = entry.spotid + spotid_len;
+            entry.bases_len = 0;
+            entries.push_back(entry);
+            data.append(spotid, spotid_len);
+        }
+        void append_bases(const char* bases, size_t len) {
+            data.append(bases, len);
+            entries.back().bases_len += int(len);
+        }
+        void add(const Fragment& fragment) {
+            start(fragment.spotid.data(), fragment.spotid.size());
+            append_bases(fragment.bases.data(), fragment.bases.size());
+        }
+        void get(size_t i, Fragment* output) const {
+            output->spotid.assign(data, entries[i].spotid, entries[i].spotid_len);
+            output->bases.assign(data, entries[i].bases, entries[i].bases_len);
+        }
+    };
+
+    // part of the source, i.e. a range of rows, for readers which can seek
+    struct Part {
+        size_t index;
+        size_t count;
+
+        Part(size_t index = 0, size_t count = 1) : index(index), count(count) {}
+
+        size_t begin(size_t total) const { return total * index / count; }
+        size_t end(size_t total) const { return total * (index + 1) / count; }
+    };
+
+    // readers which can seek have constructor with Part as first argument and redefine this to true
+    static const bool SEEKABLE = false;
+
     virtual ~Reader() {}
 
     // returns stats of original file
@@ -97,6 +160,18 @@ public:
         return !output.empty();
     }
 
+    // reads about max_count fragments into chunk, readers with chunks of their own may return more or less
+    // replaces chunk content
+    // returns true if anything was read (i.e. chunk is not empty)
+    virtual bool read_chunk(Chunk& chunk, size_t max_count) {
+        chunk.clear();
+        Fragment fragment;
+        while (chunk.size() < max_count && read(&fragment)) {
+            chunk.add(fragment);
+        }
+        return !chunk.empty();
+    }
+
     // factory params aux struct
     struct Params {
         std::string filter_file;
@@ -26,78 +26,30 @@
 
 #include "config_sort_dbs.h"
 #include <iostream>
-#include <vector>
-#include <list>
-#include <fstream>
-#include <algorithm>
+#include <string>
 #include <stdint.h>
 
 #include "log.h"
 
 using namespace std;
 
-const string VERSION = "0.12";
+const string VERSION = "0.14";
 
 typedef uint64_t hash_t;
 
-#include "dbs.h"
+#include "sort_dbs.h"
 
-typedef DBS::Kmers Kmers;
-typedef vector<hash_t> Hashes;
-
-bool split_by_tax_less(const DBS::KmerTax &a, const DBS::KmerTax &b)
+// runs go to temp dir, next to out file by default
+string run_prefix(const Config &config)
 {
-	if (a.tax_id == b.tax_id)
-		return a.kmer < b.kmer;
-
-	return a.tax_id < b.tax_id;
-}
-
-void to_hashes(const Kmers &kmers, Hashes &hashes)
-{
-	hashes.clear();
-	hashes.resize(kmers.size());
-	for (size_t i = 0; i < kmers.size(); i++)
-		hashes[i] = kmers[i].kmer;
-};
-
-struct Annot
-{
-	int tax_id;
-	size_t count;
-
-	Annot(int tax_id, size_t count) : tax_id(tax_id), count(count){}
-};
-
-typedef list<Annot> Annotation;
-
-void save_annotation(const string &filename, const Annotation &annotation)
-{
-	ofstream f(filename);
-	for (auto &a : annotation)
-		f << a.tax_id << '\t' << a.count << endl;
-}
-
-Annotation get_annotation(const Kmers &kmers)
-{
-	Annotation a;
-	if (kmers.empty())
-		return a;
-
-	size_t start = 0;
-	auto current_tax = kmers[0].tax_id;
-	for (size_t i = 1; i < kmers.size(); i++)
-		if (kmers[i].tax_id != current_tax)
-		{
-			a.push_back(Annot(current_tax, i - start));
-			start = i;
-			current_tax = kmers[i].tax_id;
-			if (current_tax <= 0)
-				throw std::runtime_error("invalid taxonomy");
-		}
-
-	a.push_back(Annot(current_tax, kmers.size() - start));
-	return a;
+	auto prefix = config.out_filename;
+	if (!config.temp_dir.empty())
+	{
+		auto slash = prefix.find_last_of('/');
+		prefix = config.temp_dir + "/" + (slash == string::npos ? prefix : prefix.substr(slash + 1));
+	}
+
+	return prefix;
 }
 
 int main(int argc, char const *argv[])
@@ -105,13 +57,12 @@ int main(int argc, char const *argv[])
 	Config config(argc, argv);
 	LOG("sort_dbs version " << VERSION);
 
-	Kmers kmers;
-	auto kmer_len = DBSIO::load_dbs(config.input_filename, kmers);
-	std::sort(kmers.begin(), kmers.end(), split_by_tax_less);
-	Hashes hashes;
-	to_hashes(kmers, hashes);
-	DBSIO::save_dbs(config.out_filename, hashes, kmer_len);
-	save_annotation(config.out_filename + ".annotation", get_annotation(kmers));
+	auto max_kmers = config.memory_mb * 1024 * 1024 / (2 * sizeof(SortDBS::TaxKmer));
+	auto stats = SortDBS::sort(config.input_filename, config.out_filename, run_prefix(config), max_kmers, config.filter_low_complexity);
+	if (config.filter_low_complexity)
+		LOG("low complexity kmers dropped: " << stats.dropped << " of " << stats.kmers + stats.dropped);
+
+	LOG("kmers saved: " << stats.kmers);
 
     return 0;
 }
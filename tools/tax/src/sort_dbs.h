@@ -0,0 +1,264 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#ifndef SORT_DBS_H_INCLUDED
+#define SORT_DBS_H_INCLUDED
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdio>
+#include "log.h"
+#include "dbs.h"
+#include "kway_merge.h"
+#include "low_complexity.h"
+
+// sorts .dbs by tax, then kmer, into hashes and annotation (tax, count per line)
+// input larger than the memory budget is sorted in runs, which are saved and merged by segments
+struct SortDBS
+{
+	// same layout as DBS::KmerTax, ordered by tax first so that kmers of a tax go together
+	struct TaxKmer : public DBS::KmerTax
+	{
+		bool operator < (const TaxKmer &x) const
+		{
+			if (tax_id == x.tax_id)
+				return kmer < x.kmer;
+
+			return tax_id < x.tax_id;
+		}
+	};
+
+	typedef std::vector<TaxKmer> Kmers;
+
+	struct Annot
+	{
+		int tax_id;
+		size_t count;
+
+		Annot(int tax_id, size_t count) : tax_id(tax_id), count(count){}
+	};
+
+	typedef std::vector<Annot> Annotation;
+
+	struct Stats
+	{
+		size_t kmers, dropped, runs;
+	};
+
+	// max_kmers - how many kmers are held in memory at once, parallel_sort needs twice as much
+	// runs are saved as <run_prefix>.run.<n> and removed when done, also on error
+	static Stats sort(const std::string &input_filename, const std::string &out_filename, const std::string &run_prefix, size_t max_kmers, bool filter_low_complexity)
+	{
+		std::ifstream f(input_filename, std::ios::binary | std::ios::in);
+		if (f.fail() || f.eof())
+			throw std::runtime_error(std::string("cannot load dbs ") + input_filename);
+
+		auto layout = DBSIO::load_layout(f, sizeof(DBS::KmerTax));
+		auto kmer_len = layout.kmer_len;
+		max_kmers = std::max(max_kmers, size_t(1));
+		LOG("kmers: " << layout.count << ", in memory at once: " << std::min(max_kmers, layout.count) << ", threads: " << omp_get_max_threads());
+
+		SortedWriter writer(out_filename, kmer_len);
+		RunFiles runs;
+		Stats stats = { 0, 0, 0 };
+		{
+			Kmers kmers;
+			for (size_t from = 0; from < layout.count; from += max_kmers)
+			{
+				IO::load_vector_data(f, kmers, std::min(max_kmers, layout.count - from));
+				if (filter_low_complexity)
+					stats.dropped += LowComplexity::filter(kmers, int(kmer_len));
+
+				parallel_sort(kmers);
+				if (layout.count <= max_kmers)
+					writer.write(kmers.data(), kmers.size());
+				else
+				{
+					runs.files.push_back(run_prefix + ".run." + std::to_string(runs.files.size()));
+					DBSIO::save_dbs(runs.files.back(), kmers, kmer_len);
+					LOG("run " << runs.files.size() << " saved to " << runs.files.back());
+				}
+			}
+		}
+
+		if (!runs.files.empty())
+			merge_runs(runs.files, writer, max_kmers);
+
+		writer.finish();
+		stats.kmers = writer.size();
+		stats.runs = runs.files.size();
+		return stats;
+	}
+
+private:
+	static void save_annotation(const std::string &filename, const Annotation &annotation)
+	{
+		std::ofstream f(filename);
+		for (auto &a : annotation)
+			f << a.tax_id << '\t' << a.count << std::endl;
+
+		if (!f)
+			throw std::runtime_error(std::string("cannot save annotation ") + filename);
+	}
+
+	// writes sorted kmers as hashes and counts kmers of every tax in the same pass
+	struct SortedWriter
+	{
+		SortedWriter(const std::string &filename, size_t kmer_len) : filename(filename), kmer_len(kmer_len), count(0), f(filename, std::ios::binary | std::ios::out)
+		{
+			if (f.fail())
+				throw std::runtime_error(std::string("cannot open output ") + filename);
+
+			DBSIO::save_header(f, kmer_len, sizeof(hash_t), 0);
+		}
+
+		void write(const TaxKmer *kmers, size_t size)
+		{
+			const size_t BLOCK = 1 << 20;
+			for (size_t from = 0; from < size; from += BLOCK)
+			{
+				auto to = std::min(size, from + BLOCK);
+				hashes.resize(to - from);
+				for (auto i = from; i < to; i++)
+				{
+					hashes[i - from] = kmers[i].kmer;
+					annotate(kmers[i].tax_id);
+				}
+
+				IO::save_vector_data(f, hashes);
+			}
+
+			count += size;
+		}
+
+		// header gets the final count
+		void finish()
+		{
+			f.seekp(0);
+			DBSIO::save_header(f, kmer_len, sizeof(hash_t), count);
+			f.close();
+			if (!f)
+				throw std::runtime_error(std::string("cannot save dbs ") + filename);
+
+			save_annotation(filename + ".annotation", annotation);
+		}
+
+		size_t size() const { return count; }
+
+	private:
+		std::string filename;
+		size_t kmer_len, count;
+		std::ofstream f;
+		std::vector<hash_t> hashes;
+		Annotation annotation;
+
+		void annotate(int tax_id)
+		{
+			if (!annotation.empty() && annotation.back().tax_id == tax_id)
+			{
+				annotation.back().count++;
+				return;
+			}
+
+			if (tax_id <= 0)
+				throw std::runtime_error("invalid taxonomy");
+
+			annotation.push_back(Annot(tax_id, 1));
+		}
+	};
+
+	struct RunFiles
+	{
+		std::vector<std::string> files;
+
+		~RunFiles()
+		{
+			for (auto &file : files)
+				std::remove(file.c_str());
+		}
+	};
+
+	// merges runs by segments which fit into memory, segments are bounded by values sampled from the runs
+	// a value sampled many times would make one huge segment, so kmers equal to a bound are written
+	// straight from the runs before the rest of the segment, being equal they need no merging
+	static void merge_runs(const std::vector<std::string> &run_files, SortedWriter &writer, size_t segment_size)
+	{
+		std::vector<DBSArray<TaxKmer>> runs(run_files.size());
+		for (size_t r = 0; r < runs.size(); r++)
+			DBSIO::load_dbs(run_files[r], runs[r]);
+
+		// there are at most runs.size() samples strictly between neighbour splitters,
+		// so the rest of a segment has at most 2 * runs.size() * step kmers
+		const size_t step = std::max(segment_size / (2 * runs.size()), size_t(1));
+		Kmers samples, splitters;
+		for (auto &run : runs)
+			for (size_t i = 0; i < run.size(); i += step)
+				samples.push_back(run[i]);
+
+		std::sort(samples.begin(), samples.end());
+		for (size_t i = runs.size(); i < samples.size(); i += runs.size())
+			if (splitters.empty() || splitters.back() < samples[i])
+				splitters.push_back(samples[i]);
+
+		std::vector<const TaxKmer*> pos(runs.size());
+		for (size_t r = 0; r < runs.size(); r++)
+			pos[r] = runs[r].begin();
+
+		Kmers segment;
+		std::vector<SortedRun<TaxKmer>> parts;
+		for (size_t s = 0; s <= splitters.size(); s++)
+		{
+			if (s > 0)
+				for (size_t r = 0; r < runs.size(); r++)
+				{
+					auto to = std::upper_bound(pos[r], runs[r].end(), splitters[s - 1]);
+					writer.write(pos[r], to - pos[r]);
+					pos[r] = to;
+				}
+
+			parts.clear();
+			size_t size = 0;
+			for (size_t r = 0; r < runs.size(); r++)
+			{
+				auto to = s < splitters.size() ? std::lower_bound(pos[r], runs[r].end(), splitters[s]) : runs[r].end();
+				parts.push_back(SortedRun<TaxKmer>(pos[r], to));
+				size += to - pos[r];
+				pos[r] = to;
+			}
+
+			segment.resize(size);
+			kway_merge(parts, segment.data(), [](const TaxKmer &kmer, size_t) { return kmer; });
+			writer.write(segment.data(), segment.size());
+		}
+	}
+};
+
+static_assert(sizeof(SortDBS::TaxKmer) == sizeof(DBS::KmerTax), "TaxKmer should be read as DBS::KmerTax");
+
+#endif
@@ -34,6 +34,10 @@
 #include <map>
 #include <memory>
 #include <algorithm>
+#include <vector>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
 
 #include "log.h"
 
@@ -103,6 +107,247 @@ struct TaxIdTree
 	}
 };
 
+// the same taxonomy in flat arrays, for many queries
+// nodes are numbered in dfs preorder, so that subtree of a node is a range of numbers
+// lca of a and b is the parent of the shallowest node in (a, b] unless a is ancestor of b
+// shallowest node is found by a sparse table over blocks of nodes, so lca and consensus take constant time
+struct FlatTaxIdTree
+{
+	static const tax_id_t ROOT = TaxIdTree::ROOT;
+	typedef std::pair<tax_id_t, tax_id_t> Parent; // tax_id, parent_tax_id
+
+	// the last parent given for a tax id wins, every parent must be given too unless it is root
+	void build(const std::vector<Parent> &parents)
+	{
+		tax_id_t root = ROOT; // not bound to references, ROOT has no definition
+		std::vector<tax_id_t> ids(1, root), parent_ids(1, root); // in input order
+		std::unordered_map<tax_id_t, int> input_index;
+		input_index[root] = 0;
+		for (auto &p : parents)
+		{
+			if (!p.first || !p.second)
+				throw std::runtime_error(std::string("bad tax id: ") + std::to_string(p.first));
+
+			if (p.first == ROOT)
+				continue;
+
+			auto it = input_index.find(p.first);
+			if (it != input_index.end())
+				parent_ids[it->second] = p.second;
+			else
+			{
+				input_index[p.first] = int(ids.size());
+				ids.push_back(p.first);
+				parent_ids.push_back(p.second);
+			}
+		}
+
+		int n = int(ids.size());
+		std::vector<int> input_parent(n, 0), child_offsets(n + 1, 0), children(n);
+		for (int i = 1; i < n; i++)
+		{
+			auto it = input_index.find(parent_ids[i]);
+			if (it == input_index.end())
+				throw std::runtime_error(std::string("no such tax_id as ") + std::to_string(parent_ids[i]));
+
+			input_parent[i] = it->second;
+			child_offsets[input_parent[i] + 1]++;
+		}
+
+		for (int i = 0; i < n; i++)
+			child_offsets[i + 1] += child_offsets[i];
+
+		{
+			auto fill = child_offsets;
+			for (int i = 1; i < n; i++)
+				children[fill[input_parent[i]]++] = i;
+		}
+
+		// preorder
+		std::vector<int> preorder_of(n, -1), order, stack(1, 0);
+		order.reserve(n);
+		while (!stack.empty())
+		{
+			int v = stack.back();
+			stack.pop_back();
+			preorder_of[v] = int(order.size());
+			order.push_back(v);
+			for (int c = child_offsets[v + 1] - 1; c >= child_offsets[v]; c--)
+				stack.push_back(children[c]);
+		}
+
+		if (int(order.size()) != n)
+			throw std::runtime_error("tax tree has a cycle");
+
+		tax_ids.resize(n);
+		parent.resize(n);
+		depth.resize(n);
+		subtree_end.resize(n);
+		for (int v = 0; v < n; v++)
+		{
+			tax_ids[v] = ids[order[v]];
+			parent[v] = preorder_of[input_parent[order[v]]];
+			depth[v] = v == 0 ? 0 : depth[parent[v]] + 1; // parent goes first in preorder
+			subtree_end[v] = v + 1;
+		}
+
+		for (int v = n - 1; v > 0; v--)
+			subtree_end[parent[v]] = std::max(subtree_end[parent[v]], subtree_end[v]);
+
+		build_index();
+		build_sparse_table();
+	}
+
+	size_t size() const { return tax_ids.size(); }
+
+	tax_id_t consensus_of(tax_id_t tax_a, tax_id_t tax_b) const
+	{
+		if (tax_a == ROOT || tax_b == ROOT)
+			return ROOT;
+
+		if (tax_a == tax_b)
+			return tax_a;
+
+		return tax_ids[lca(node_of(tax_a), node_of(tax_b))];
+	}
+
+	bool a_sub_b(tax_id_t tax_a, tax_id_t tax_b) const
+	{
+		if (tax_a == tax_b || tax_b == ROOT)
+			return true;
+
+		int b = node_of(tax_b);
+		int a = find_node(tax_a);
+		return a >= 0 && is_ancestor(b, a);
+	}
+
+	tax_id_t get_parent_id(tax_id_t tax_id) const
+	{
+		return tax_ids[parent[node_of(tax_id)]];
+	}
+
+private:
+	static const int BLOCK_BITS = 4;
+	typedef uint64_t DepthKey; // depth << 32 | node, min key is the shallowest node
+
+	std::vector<tax_id_t> tax_ids;
+	std::vector<int> parent, depth, subtree_end;
+	std::vector<int> dense_index; // tax_id -> node, when tax ids are dense enough
+	std::unordered_map<tax_id_t, int> sparse_index; // otherwise
+	std::vector<std::vector<DepthKey> > block_min; // [level][block], min of 2^level blocks
+
+	void build_index()
+	{
+		dense_index.clear();
+		sparse_index.clear();
+		auto max_tax_id = *std::max_element(tax_ids.begin(), tax_ids.end());
+		if (max_tax_id / 8 < tax_ids.size() + 1024*1024)
+		{
+			dense_index.assign(size_t(max_tax_id) + 1, -1);
+			for (int v = 0; v < int(tax_ids.size()); v++)
+				dense_index[tax_ids[v]] = v;
+		}
+		else
+			for (int v = 0; v < int(tax_ids.size()); v++)
+				sparse_index[tax_ids[v]] = v;
+	}
+
+	DepthKey key(int v) const { return (DepthKey(depth[v]) << 32) | DepthKey(v); }
+
+	void build_sparse_table()
+	{
+		int n = int(tax_ids.size());
+		int blocks = ((n - 1) >> BLOCK_BITS) + 1;
+		block_min.assign(1, std::vector<DepthKey>(blocks, std::numeric_limits<DepthKey>::max()));
+		for (int v = 0; v < n; v++)
+			block_min[0][v >> BLOCK_BITS] = std::min(block_min[0][v >> BLOCK_BITS], key(v));
+
+		for (int level = 1; (1 << level) <= blocks; level++)
+		{
+			auto &prev = block_min[level - 1];
+			std::vector<DepthKey> mins(blocks - (1 << level) + 1);
+			for (size_t b = 0; b < mins.size(); b++)
+				mins[b] = std::min(prev[b], prev[b + (1 << (level - 1))]);
+
+			block_min.push_back(std::move(mins));
+		}
+	}
+
+	int find_node(tax_id_t tax_id) const
+	{
+		if (!dense_index.empty())
+			return tax_id < dense_index.size() ? dense_index[tax_id] : -1;
+
+		auto it = sparse_index.find(tax_id);
+		return it == sparse_index.end() ? -1 : it->second;
+	}
+
+	int node_of(tax_id_t tax_id) const
+	{
+		int v = find_node(tax_id);
+		if (v < 0)
+		{
+			auto message = std::string("no such tax_id as ") + std::to_string(tax_id);
+			LOG(message);
+			throw std::runtime_error(message);
+		}
+
+		return v;
+	}
+
+	bool is_ancestor(int a, int b) const { return a <= b && b < subtree_end[a]; }
+
+	DepthKey min_in_nodes(int from, int to) const // [from, to)
+	{
+		DepthKey m = std::numeric_limits<DepthKey>::max();
+		for (int v = from; v < to; v++)
+			m = std::min(m, key(v));
+
+		return m;
+	}
+
+	static int floor_log2(unsigned int x) // x > 0
+	{
+#if defined(__GNUC__)
+		return 31 - __builtin_clz(x);
+#else
+		int log = 0;
+		while (x >>= 1)
+			log++;
+		return log;
+#endif
+	}
+
+	DepthKey min_in_blocks(int from, int to) const // [from, to)
+	{
+		if (from >= to)
+			return std::numeric_limits<DepthKey>::max();
+
+		int level = floor_log2(unsigned(to - from));
+		return std::min(block_min[level][from], block_min[level][to - (1 << level)]);
+	}
+
+	int lca(int a, int b) const
+	{
+		if (a > b)
+			std::swap(a, b);
+
+		if (is_ancestor(a, b))
+			return a;
+
+		// shallowest node in (a, b] is a child of lca
+		int from = a + 1, to = b + 1;
+		int from_block = from >> BLOCK_BITS, to_block = to >> BLOCK_BITS;
+		DepthKey m;
+		if (from_block == to_block)
+			m = min_in_nodes(from, to);
+		else
+			m = std::min(std::min(min_in_nodes(from, (from_block + 1) << BLOCK_BITS), min_in_nodes(to_block << BLOCK_BITS, to)), min_in_blocks(from_block + 1, to_block));
+
+		return parent[int(m & 0xffffffff)];
+	}
+};
+
 struct TaxIdTreeLoader
 {
 	static void load_tax_id_tree(TaxIdTree &tax_id_tree, const std::string &filename)
@@ -126,6 +371,28 @@ struct TaxIdTreeLoader
 		calculate_subids(tax_id_tree);
 	}
 
+	static void load_tax_id_tree(FlatTaxIdTree &tax_id_tree, const std::string &filename)
+	{
+		std::ifstream f(filename);
+		if (f.fail() || f.eof())
+			throw std::runtime_error(std::string("cannot open file ") + filename);
+
+		std::vector<FlatTaxIdTree::Parent> parents;
+		tax_id_t x = 0, parent = 0;
+		while (f >> x)
+		{
+			if (!(f >> parent) || !x || !parent)
+				throw std::runtime_error(std::string("bad tax id: ") + std::to_string(x));
+
+			parents.push_back(FlatTaxIdTree::Parent(x, parent));
+		}
+
+		if (!f.eof())
+			throw std::runtime_error(std::string("bad tax id format in ") + filename);
+
+		tax_id_tree.build(parents);
+	}
+
 	static void calculate_subids(TaxIdTree &tax_id_tree)
 	{
 		std::set<TaxIdTree::Node*> nodes;
@@ -0,0 +1,238 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include <random>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include "tests.h"
+
+typedef uint64_t hash_t;
+
+#include "config_align_to.h"
+#include "aligns_to_dbs_job.h"
+#include "aligns_to_server.h"
+
+const int KMER_LEN = 32;
+const char *DBS_FILE = "aligns_to_server_test.dbs";
+const char *FASTA_FILE = "aligns_to_server_test.fasta";
+const char *SOCKET_FILE = "aligns_to_server_test.sock";
+
+std::string random_bases(size_t len, std::mt19937 &rng)
+{
+    std::string s;
+    for (size_t i = 0; i < len; i++)
+        s += "ACGT"[rng() % 4];
+    return s;
+}
+
+// two genomes, reads from both and from neither
+std::string make_fixture()
+{
+    std::mt19937 rng(1);
+    std::string genomes[] = { random_bases(500, rng), random_bases(500, rng) };
+
+    std::map<hash_t, int> kmers;
+    for (int tax = 1; tax <= 2; tax++)
+        Hash<hash_t>::for_all_canonical_hashes_do(genomes[tax - 1], KMER_LEN, [&](hash_t kmer, int pos) {
+            kmers[kmer] = tax;
+            return true;
+        });
+
+    std::vector<DBSJob::KmerTax> db;
+    for (auto &k : kmers)
+        db.push_back(DBSJob::KmerTax(k.first, k.second));
+    DBSIO::save_dbs(DBS_FILE, db, KMER_LEN);
+
+    std::ostringstream fasta;
+    for (int i = 0; i < 30; i++)
+    {
+        auto bases = i % 3 == 2 ? random_bases(100, rng) : genomes[i % 3].substr(rng() % 400, 100);
+        fasta << ">read" << i << std::endl << bases << std::endl;
+    }
+
+    std::ofstream(FASTA_FILE) << fasta.str();
+    return fasta.str();
+}
+
+std::string sorted_lines(const std::string &text)
+{
+    std::istringstream in(text);
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(in, line))
+        lines.push_back(line);
+    std::sort(lines.begin(), lines.end());
+
+    std::string sorted;
+    for (auto &l : lines)
+        sorted += l + "\n";
+    return sorted;
+}
+
+template <class Lambda>
+bool throws(Lambda &&lambda)
+{
+    try
+    {
+        lambda();
+    }
+    catch (std::runtime_error &)
+    {
+        return true;
+    }
+
+    return false;
+}
+
+// returns client's stdout
+std::string request(const std::string &input, const std::string &stdin_text, int expected_code)
+{
+    std::istringstream fake_in(stdin_text);
+    std::ostringstream fake_out;
+    auto cin_buf = std::cin.rdbuf(fake_in.rdbuf());
+    auto cout_buf = std::cout.rdbuf(fake_out.rdbuf());
+    int code = AlignsToServer::request(SOCKET_FILE, input);
+    std::cin.rdbuf(cin_buf);
+    std::cout.rdbuf(cout_buf);
+    ASSERT_EQUALS(code, expected_code);
+    return fake_out.str();
+}
+
+TEST(aligns_to_server) {
+    auto fasta = make_fixture();
+    const char *argv[] = { "aligns_to", "-dbs", DBS_FILE, "-server", SOCKET_FILE };
+    Config config(5, argv);
+    DBSBasicJob job(config);
+
+    std::ostringstream expected;
+    job.run(FASTA_FILE, expected);
+    std::string expected_lines;
+    for (int i = 0; i < 30; i++)
+        if (i % 3 != 2)
+            expected_lines += "read" + std::to_string(i) + "\t" + std::to_string(i % 3 + 1) + "x69\n";
+    ASSERT_EQUALS(sorted_lines(expected.str()), sorted_lines(expected_lines));
+
+    std::string server_error;
+    std::atomic<bool> server_failed(false);
+    std::thread server([&]() {
+        try
+        {
+            AlignsToServer::serve(job, SOCKET_FILE);
+        }
+        catch (std::exception &e)
+        {
+            server_error = e.what();
+            server_failed = true;
+        }
+    });
+
+    // server may fail before it binds, so the socket file is waited for a few seconds only
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (access(SOCKET_FILE, F_OK) != 0 && !server_failed && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    if (server_failed)
+    {
+        server.join();
+        ASSERT_EQUALS(server_error, "");
+    }
+    ASSERT(access(SOCKET_FILE, F_OK) == 0);
+
+    ASSERT_EQUALS(sorted_lines(request(FASTA_FILE, "", 0)), sorted_lines(expected.str()));
+    ASSERT(throws([]() { UnixSocket::listen(SOCKET_FILE); })); // running server keeps its socket
+    ASSERT_EQUALS(sorted_lines(request("-", fasta, 0)), sorted_lines(expected.str()));
+    ASSERT_EQUALS(request("aligns_to_server_test_missing.fasta", "", 1), "");
+    ASSERT_EQUALS(request("-", ">a\n>b\nACGT\n", 1), ""); // empty read, server keeps running
+    ASSERT_EQUALS(sorted_lines(request(FASTA_FILE, "", 0)), sorted_lines(expected.str()));
+    ASSERT_EQUALS(request("", "", 0), ""); // stop
+    server.join();
+    ASSERT_EQUALS(server_error, "");
+    ASSERT(access(SOCKET_FILE, F_OK) != 0);
+
+    std::remove(DBS_FILE);
+    std::remove(FASTA_FILE);
+}
+
+// batch of inputs at once, like aligns_to -batch: a bad input fails alone
+TEST(aligns_to_batch) {
+    make_fixture();
+    const char *BAD_FILE = "aligns_to_server_test_bad.fasta";
+    std::ofstream(BAD_FILE) << ">a" << std::endl << ">b" << std::endl << "ACGT" << std::endl;
+    const char *argv[] = { "aligns_to", "-dbs", DBS_FILE, FASTA_FILE };
+    Config config(4, argv);
+    DBSBasicJob job(config);
+    std::ostringstream expected;
+    job.run(FASTA_FILE, expected);
+
+    const char *inputs[] = { BAD_FILE, FASTA_FILE, BAD_FILE, FASTA_FILE };
+    std::string out[4], error[4];
+    omp_set_max_active_levels(2);
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(2)
+    for (int i = 0; i < 4; i++)
+    {
+        omp_set_num_threads(2);
+        try
+        {
+            std::ostringstream f;
+            job.run(inputs[i], f);
+            out[i] = f.str();
+        }
+        catch (std::exception &e)
+        {
+            error[i] = e.what();
+        }
+    }
+
+    for (int i = 0; i < 4; i++)
+    {
+        ASSERT_EQUALS(error[i], i % 2 ? "" : "Read is empty");
+        ASSERT_EQUALS(sorted_lines(out[i]), i % 2 ? sorted_lines(expected.str()) : "");
+    }
+
+    std::remove(BAD_FILE);
+    std::remove(DBS_FILE);
+    std::remove(FASTA_FILE);
+}
+
+TEST(unix_socket_listen) {
+    { UnixSocket::listen(SOCKET_FILE); } // socket file is left behind, like after a crash
+    ASSERT(access(SOCKET_FILE, F_OK) == 0);
+    {
+        auto listener = UnixSocket::listen(SOCKET_FILE); // stale socket is replaced
+        UnixSocket::connect(SOCKET_FILE);
+    }
+    std::remove(SOCKET_FILE);
+
+    std::ofstream(FASTA_FILE) << ">a" << std::endl << "ACGT" << std::endl;
+    ASSERT(throws([]() { UnixSocket::listen(FASTA_FILE); })); // mistyped path is not removed
+    ASSERT(access(FASTA_FILE, F_OK) == 0);
+    std::remove(FASTA_FILE);
+}
+
+TEST_MAIN();
@@ -0,0 +1,131 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include <random>
+#include "tests.h"
+#include "kmer_map.h"
+#include "contig_builder.h"
+
+typedef KmerMap32::hash_t hash_t;
+
+// reads of small genomes sharing pieces, with repeated errors, some reads are reverse complement
+// so that contigs branch and seeds of a round run into each other
+std::vector<std::string> random_reads(std::mt19937 &rng)
+{
+    std::vector<std::string> genomes(30);
+    for (auto &genome : genomes)
+        for (int i = 0; i < 300; i++)
+            genome += "ACGT"[rng() % 4];
+
+    for (size_t g = 1; g < genomes.size(); g++)
+        genomes[g].replace(100, 60, genomes[g - 1].substr(200, 60));
+
+    std::vector<std::string> reads;
+    for (int i = 0; i < 3000; i++)
+    {
+        auto &genome = genomes[rng() % genomes.size()];
+        auto read = genome.substr(rng() % (genome.size() - 80), 80);
+        if (rng() % 4 == 0)
+            read[rng() % read.size()] = "ACGT"[rng() % 4];
+        if (rng() % 3 == 0)
+            seq_transform_actg::to_rev_complement(read);
+        for (int copy = 0; copy < 2; copy++)
+            reads.push_back(read);
+    }
+
+    return reads;
+}
+
+void add_reads(KmerMap32 &kmers, const std::vector<std::string> &reads)
+{
+    for (auto &read : reads)
+        Hash<hash_t>::for_all_hashes_do(read, kmers.kmer_len, [&](hash_t hash) {
+            kmers.add(hash);
+            return true;
+        });
+}
+
+// one seed at a time, as contig_builder did before rounds
+std::list<std::string> sequential_contigs(KmerMap32 &kmers, int min_len)
+{
+    std::list<std::string> contigs;
+    Begins<KmerMap32> begins(kmers);
+    hash_t hash = 0;
+    while (begins.next(&hash))
+    {
+        auto contig = ContigBuilder::get_next_contig(kmers, ContigBuilder::restore_orientation(hash, kmers));
+        if (int(contig.length()) >= min_len)
+            contigs.push_back(contig);
+    }
+
+    return contigs;
+}
+
+TEST(contig_builder_rounds) {
+    std::mt19937 rng(3);
+    auto reads = random_reads(rng);
+    const int MIN_LEN = 40;
+
+    KmerMap32 expected_kmers;
+    add_reads(expected_kmers, reads);
+    auto expected = sequential_contigs(expected_kmers, MIN_LEN);
+    ASSERT(expected.size() > 2);
+
+    for (int threads : { 1, 4 })
+    {
+        omp_set_num_threads(threads);
+        KmerMap32 kmers;
+        add_reads(kmers, reads);
+        size_t rebuilt = 0;
+        auto contigs = ContigBuilder::build_contigs(kmers, MIN_LEN, &rebuilt);
+        ASSERT(rebuilt > 0); // seeds of a round overlap
+        ASSERT_EQUALS(contigs.size(), expected.size());
+        ASSERT(contigs == expected);
+    }
+}
+
+// kmer added as is at least once keeps this orientation, whatever came first
+// (it used to be the orientation of the first add), so is the contig built from it
+TEST(contig_builder_orientation) {
+    std::mt19937 rng(4);
+    std::string read;
+    for (int i = 0; i < 80; i++)
+        read += "ACGT"[rng() % 4];
+
+    auto rev_compl = read;
+    seq_transform_actg::to_rev_complement(rev_compl);
+
+    KmerMap32 kmers;
+    add_reads(kmers, { rev_compl, read });
+    auto kmer = Hash<hash_t>::hash_of(read.c_str(), kmers.kmer_len);
+    ASSERT_EQUALS(ContigBuilder::restore_orientation(seq_transform<hash_t>::min_hash_variant(kmer, kmers.kmer_len), kmers), kmer);
+
+    auto contigs = ContigBuilder::build_contigs(kmers, 40);
+    ASSERT_EQUALS(contigs.size(), 1u);
+    ASSERT_EQUALS(contigs.front(), read);
+}
+
+TEST_MAIN();
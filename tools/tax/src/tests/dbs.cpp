@@ -0,0 +1,165 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include <cstdio>
+#include "tests.h"
+
+typedef uint64_t hash_t;
+
+#include "dbs.h"
+
+const char *DBS_FILE = "dbs_test.dbs";
+
+DBS::Kmers test_kmers(size_t count)
+{
+    DBS::Kmers kmers;
+    for (size_t i = 0; i < count; i++)
+        kmers.push_back(DBS::KmerTax(hash_t(i) * 0x9E3779B97F4A7C15ull, int(i % 7 + 1)));
+
+    return kmers;
+}
+
+void assert_same(const DBSArray<DBS::KmerTax> &loaded, const DBS::Kmers &kmers)
+{
+    ASSERT_EQUALS(loaded.size(), kmers.size());
+    for (size_t i = 0; i < kmers.size(); i++)
+    {
+        ASSERT_EQUALS(loaded[i].kmer, kmers[i].kmer);
+        ASSERT_EQUALS(loaded[i].tax_id, kmers[i].tax_id);
+    }
+}
+
+template <class Lambda>
+bool throws(Lambda &&lambda)
+{
+    try
+    {
+        lambda();
+    }
+    catch (std::runtime_error &)
+    {
+        return true;
+    }
+
+    return false;
+}
+
+std::vector<char> file_data(const std::string &filename)
+{
+    std::vector<char> data(IO::filesize(filename));
+    std::ifstream(filename, std::ios::binary).read(data.data(), data.size());
+    return data;
+}
+
+TEST(dbs_round_trip) {
+    auto kmers = test_kmers(1000);
+    DBSIO::save_dbs(DBS_FILE, kmers, 32);
+    ASSERT_EQUALS(IO::filesize(DBS_FILE), DBSIO::DATA_ALIGNMENT + kmers.size() * sizeof(DBS::KmerTax));
+
+    {
+        std::ifstream f(DBS_FILE, std::ios::binary | std::ios::in);
+        auto layout = DBSIO::load_layout(f, sizeof(DBS::KmerTax));
+        ASSERT_EQUALS(layout.version, size_t(DBSIO::MAPPED_VERSION));
+        ASSERT_EQUALS(layout.kmer_len, 32);
+        ASSERT_EQUALS(layout.count, kmers.size());
+        ASSERT_EQUALS(layout.data_offset, size_t(DBSIO::DATA_ALIGNMENT));
+        ASSERT_EQUALS(size_t(f.tellg()), size_t(DBSIO::DATA_ALIGNMENT));
+    }
+
+    DBS::Kmers loaded;
+    ASSERT_EQUALS(DBSIO::load_dbs(DBS_FILE, loaded), 32);
+    DBSArray<DBS::KmerTax> in_memory;
+    in_memory.assign(std::move(loaded));
+    assert_same(in_memory, kmers);
+
+    DBSArray<DBS::KmerTax> mapped;
+    ASSERT_EQUALS(DBSIO::load_dbs(DBS_FILE, mapped), 32);
+    assert_same(mapped, kmers);
+    ASSERT_EQUALS(size_t(mapped.begin()) % sizeof(hash_t), 0); // kmers are used in place
+
+    DBSIO::save_dbs(DBS_FILE, DBS::Kmers(), 20);
+    ASSERT_EQUALS(DBSIO::load_dbs(DBS_FILE, mapped), 20);
+    ASSERT(mapped.empty());
+
+    std::remove(DBS_FILE);
+}
+
+TEST(dbs_damaged) {
+    auto kmers = test_kmers(1000);
+    DBSIO::save_dbs(DBS_FILE, kmers, 32);
+    auto data = file_data(DBS_FILE);
+    DBS::Kmers loaded;
+    DBSArray<DBS::KmerTax> mapped;
+
+    // any header byte before the checksum is covered by it
+    auto damaged = data;
+    damaged[offsetof(DBSIO::DBSMappedHeader, count)] ^= 1;
+    std::ofstream(DBS_FILE, std::ios::binary).write(damaged.data(), damaged.size());
+    ASSERT(throws([&]() { DBSIO::load_dbs(DBS_FILE, loaded); }));
+    ASSERT(throws([&]() { DBSIO::load_dbs(DBS_FILE, mapped); }));
+
+    damaged = data;
+    damaged[offsetof(DBSIO::DBSMappedHeader, checksum)] ^= 1;
+    std::ofstream(DBS_FILE, std::ios::binary).write(damaged.data(), damaged.size());
+    ASSERT(throws([&]() { DBSIO::load_dbs(DBS_FILE, mapped); }));
+
+    // header is fine, kmers are cut
+    std::ofstream(DBS_FILE, std::ios::binary).write(data.data(), data.size() - sizeof(DBS::KmerTax));
+    ASSERT(throws([&]() { DBSIO::load_dbs(DBS_FILE, mapped); }));
+
+    std::ofstream(DBS_FILE, std::ios::binary).write(data.data(), sizeof(DBSIO::DBSMappedHeader) / 2);
+    ASSERT(throws([&]() { DBSIO::load_dbs(DBS_FILE, mapped); }));
+
+    // other element type
+    DBSIO::save_dbs(DBS_FILE, std::vector<hash_t>(10), 32);
+    ASSERT(throws([&]() { DBSIO::load_dbs(DBS_FILE, mapped); }));
+
+    std::remove(DBS_FILE);
+}
+
+// files saved before the mapped format: header, kmer count, kmers
+TEST(dbs_version_1) {
+    auto kmers = test_kmers(1000);
+    {
+        std::ofstream f(DBS_FILE, std::ios::binary | std::ios::out);
+        IO::write(f, DBSIO::DBSHeader(25));
+        IO::save_vector(f, kmers);
+    }
+
+    DBS::Kmers loaded;
+    ASSERT_EQUALS(DBSIO::load_dbs(DBS_FILE, loaded), 25);
+    DBSArray<DBS::KmerTax> in_memory;
+    in_memory.assign(std::move(loaded));
+    assert_same(in_memory, kmers);
+
+    DBSArray<DBS::KmerTax> mapped;
+    ASSERT_EQUALS(DBSIO::load_dbs(DBS_FILE, mapped), 25);
+    assert_same(mapped, kmers);
+
+    std::remove(DBS_FILE);
+}
+
+TEST_MAIN();
@@ -130,4 +130,80 @@ TEST(hash_for_all) {
     ASSERT_EQUALS(counter[Hash<unsigned int>::hash_of("CCACGAGA")], 1);
 }
 
+TEST(hash_for_all_in_buffer) {
+    string buffer = "ACGTACGTTTGCAGTCAAAAC";
+    vector<unsigned int> hashes;
+    Hash<unsigned int>::for_all_hashes_do(&buffer[2], 12, 8, [&](unsigned int hash)
+        {
+            hashes.push_back(hash);
+            return true;
+        });
+
+    ASSERT_EQUALS(hashes.size(), 5u);
+    for (size_t i = 0; i < hashes.size(); i++)
+        ASSERT_EQUALS(hashes[i], Hash<unsigned int>::hash_of(&buffer[2 + i], 8));
+
+    int count = 0;
+    Hash<unsigned int>::for_all_hashes_do(&buffer[2], 12, 8, [&](unsigned int) { return ++count < 2; });
+    ASSERT_EQUALS(count, 2);
+}
+
+TEST(hash_rolling) {
+    string seq = "TCTCCGAGCCCACGAGACNNGTCAGTCAGTCAAAAAtcgaGCCCACGAGAC";
+    const int KMER_LEN = 8;
+    RollingKmer<unsigned int> kmer(KMER_LEN);
+    for (int i = 0; i < int(seq.length()); i++)
+    {
+        bool valid = i >= KMER_LEN - 1 && seq.substr(i - KMER_LEN + 1, KMER_LEN).find('N') == string::npos;
+        ASSERT_EQUALS(kmer.add(seq[i]), valid);
+        if (valid)
+        {
+            auto hash = Hash<unsigned int>::hash_of(&seq[i - KMER_LEN + 1], KMER_LEN);
+            ASSERT_EQUALS(kmer.forward(), hash);
+            ASSERT_EQUALS(kmer.reverse_complement(), seq_transform<unsigned int>::to_rev_complement(hash, KMER_LEN));
+        }
+    }
+}
+
+TEST(hash_for_all_canonical) {
+    string seq = "CTATACGATCGAGGTCATCGACCTGATGAAGGACCCGGCCTTGGCGCAGCGCGACCAGATCGTCGCGATCCCGACGCTG";
+    seq[40] = 'N';
+    for (int kmer_len : {1, 16, 31, 32})
+    {
+        std::map<int, uint64_t> found;
+        Hash<uint64_t>::for_all_canonical_hashes_do(seq, kmer_len, [&](uint64_t hash, int pos)
+            {
+                found[pos] = hash;
+                return true;
+            });
+
+        size_t expected = 0;
+        for (int pos = 0; pos + kmer_len <= int(seq.length()); pos++)
+            if (pos > 40 || pos + kmer_len <= 40)
+            {
+                expected++;
+                auto hash = Hash<uint64_t>::hash_of(&seq[pos], kmer_len);
+                ASSERT_EQUALS(found[pos], seq_transform<uint64_t>::min_hash_variant(hash, kmer_len));
+            }
+
+        ASSERT_EQUALS(found.size(), expected);
+    }
+}
+
+TEST(hash_for_all_canonical_long) {
+#if defined ( __GNUC__ )
+    string seq = "CTATACGATCGAGGTCATCGACCTGATGAAGGACCCGGCCTTGGCGCAGCGCGACCAGATCGTCGCGATCCCGACGCTG";
+    int count = 0;
+    Hash<__uint128_t>::for_all_canonical_hashes_do(seq, 64, [&](__uint128_t hash, int pos)
+        {
+            auto expected = seq_transform<__uint128_t>::min_hash_variant(Hash<__uint128_t>::hash_of(&seq[pos], 64), 64);
+            ASSERT_EQUALS(hash == expected, true);
+            count++;
+            return count < 10;
+        });
+
+    ASSERT_EQUALS(count, 10);
+#endif
+}
+
 TEST_MAIN();
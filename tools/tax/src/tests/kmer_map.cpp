@@ -0,0 +1,132 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include <random>
+#include <map>
+#include "tests.h"
+#include "kmer_map.h"
+
+std::vector<std::string> random_reads(int count, int len, std::mt19937 &rng)
+{
+    std::string genome;
+    for (int i = 0; i < 5000; i++)
+        genome += "ACGT"[rng() % 4];
+
+    std::vector<std::string> reads;
+    for (int i = 0; i < count; i++)
+        reads.push_back(genome.substr(rng() % (genome.size() - len), len)); // overlapping, so most kmers repeat
+    return reads;
+}
+
+template <class TestKmerMap>
+void check_map()
+{
+    typedef typename TestKmerMap::hash_t hash_t;
+    const int kmer_len = TestKmerMap::kmer_len;
+    std::mt19937 rng(kmer_len);
+    auto reads = random_reads(3000, 150, rng);
+
+    TestKmerMap kmers;
+    #pragma omp parallel for num_threads(8) schedule(dynamic, 16)
+    for (size_t i = 0; i < reads.size(); i++)
+        Hash<hash_t>::for_all_hashes_do(reads[i], kmer_len, [&](hash_t hash) {
+            kmers.add(hash);
+            return true;
+        });
+
+    std::map<hash_t, unsigned int> expected;
+    size_t weight = 0;
+    for (auto &read : reads)
+        Hash<hash_t>::for_all_hashes_do(read, kmer_len, [&](hash_t hash) {
+            expected[seq_transform<hash_t>::min_hash_variant(hash, kmer_len)]++;
+            weight++;
+            return true;
+        });
+
+    ASSERT_EQUALS(kmers.size(), expected.size());
+    ASSERT_EQUALS(kmers.total_weight(), weight);
+    for (auto &e : expected)
+    {
+        ASSERT_EQUALS(kmers.get(e.first), e.second);
+        ASSERT_EQUALS(kmers.coverage_of(seq_transform<hash_t>::to_rev_complement(e.first, kmer_len)), e.second);
+    }
+
+    // a single kmer keeps the orientation it was added in
+    TestKmerMap single;
+    hash_t kmer = Hash<hash_t>::hash_of(reads[0].c_str(), kmer_len);
+    single.add(kmer);
+    ASSERT(!single.originally_complement(kmer) && !single.originally_reverse(kmer));
+    auto rev_compl = seq_transform<hash_t>::to_rev_complement(kmer, kmer_len);
+    ASSERT(single.originally_complement(rev_compl) && single.originally_reverse(rev_compl));
+    single.add(rev_compl);
+    auto canonical = seq_transform<hash_t>::min_hash_variant(kmer, kmer_len);
+    ASSERT(!single.originally_complement(canonical) && !single.originally_reverse(canonical));
+
+    // remove, restore
+    auto some = expected.begin()->first;
+    kmers.remove(some);
+    ASSERT_EQUALS(kmers.get(some), 0u);
+    ASSERT_EQUALS(kmers.coverage_of_no_deleted_check(some), expected.begin()->second);
+    kmers.restore(some);
+    ASSERT_EQUALS(kmers.get(some), expected.begin()->second);
+
+    // optimize drops single kmers
+    kmers.optimize();
+    size_t frequent = 0, frequent_weight = 0;
+    for (auto &e : expected)
+    {
+        ASSERT_EQUALS(kmers.get(e.first), e.second >= 2 ? e.second : 0);
+        if (e.second >= 2)
+        {
+            frequent++;
+            frequent_weight += e.second;
+        }
+    }
+
+    ASSERT_EQUALS(kmers.size(), frequent);
+    ASSERT_EQUALS(kmers.total_weight(), frequent_weight);
+
+    size_t visited = 0;
+    kmers.for_every_kmer_do([&](hash_t hash, unsigned int count) {
+        ASSERT_EQUALS(count, expected[hash]);
+        visited++;
+    });
+    ASSERT_EQUALS(visited, frequent);
+}
+
+TEST(kmer_map_16) {
+    check_map<KmerMap16>();
+}
+
+TEST(kmer_map_32) {
+    check_map<KmerMap32>();
+}
+
+TEST(kmer_map_64) {
+    check_map<KmerMap64>();
+}
+
+TEST_MAIN();
@@ -0,0 +1,130 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+// lookups per second for every search layout, single and batched, on a synthetic array of canonical 32-mers
+// usage: kmer_search_bench [kmer count, default 1e9] [lookup count, default 1e7]
+
+#include "tests.h"
+#include <random>
+#include "omp_adapter.h"
+
+typedef uint64_t hash_t;
+
+#include "dbs.h"
+#include "kmer_search.h"
+
+struct KmerTax : public DBS::KmerTax
+{
+    KmerTax(hash_t kmer = 0, int tax_id = 0) : DBS::KmerTax(kmer, tax_id) {}
+    bool operator < (const KmerTax &x) const { return kmer < x.kmer; }
+};
+
+static const int KMER_LEN = 32;
+
+std::vector<KmerTax> synthetic_kmers(size_t count)
+{
+    std::vector<KmerTax> kmers(count);
+    #pragma omp parallel
+    {
+        std::mt19937_64 rng(omp_get_thread_num());
+        #pragma omp for
+        for (size_t i = 0; i < count; i++)
+            kmers[i] = KmerTax(seq_transform<hash_t>::min_hash_variant(rng(), KMER_LEN), int(i % 1000) + 1);
+    }
+    std::sort(kmers.begin(), kmers.end());
+    return kmers;
+}
+
+std::vector<hash_t> synthetic_queries(const std::vector<KmerTax> &kmers, size_t count)
+{
+    std::mt19937_64 rng(12345);
+    std::vector<hash_t> queries(count);
+    for (size_t i = 0; i < count; i++)
+        queries[i] = (i % 2) ? kmers[rng() % kmers.size()].kmer : seq_transform<hash_t>::min_hash_variant(rng(), KMER_LEN); // half hits, half misses
+    return queries;
+}
+
+size_t run_layout(const std::vector<KmerTax> &kmers, const std::vector<hash_t> &queries, SearchLayout layout, bool batched, std::vector<int> &found)
+{
+    auto before = high_resolution_clock::now();
+    KmerSearch<KmerTax, hash_t> search(kmers.data(), kmers.size(), KMER_LEN, layout);
+    auto build_ms = duration_cast<milliseconds>(high_resolution_clock::now() - before).count();
+
+    found.resize(queries.size());
+    before = high_resolution_clock::now();
+    if (batched)
+    {
+        const size_t BATCH_SIZE = KmerSearch<KmerTax, hash_t>::BATCH_SIZE;
+        #pragma omp parallel for
+        for (size_t from = 0; from < queries.size(); from += BATCH_SIZE)
+        {
+            size_t i = from;
+            search.find_batch(&queries[from], std::min(BATCH_SIZE, queries.size() - from), [&](const KmerTax *it, hash_t)
+                {
+                    found[i++] = it ? it->tax_id : 0;
+                    return true;
+                });
+        }
+    }
+    else
+    {
+        #pragma omp parallel for
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            auto it = search.find(queries[i]);
+            found[i] = it ? it->tax_id : 0;
+        }
+    }
+    auto seconds = duration_cast<duration<double>>(high_resolution_clock::now() - before).count();
+
+    size_t lookups_per_sec = size_t(queries.size() / std::max(seconds, 1e-9));
+    cout << search_layout_name(layout) << (batched ? " batched" : "") << "\tbuild (ms) " << build_ms << "\tlookups/sec " << lookups_per_sec << "\tthreads " << omp_get_max_threads() << endl;
+    return lookups_per_sec;
+}
+
+int main(int argc, char const *argv[])
+{
+    size_t kmer_count = argc > 1 ? size_t(std::stod(argv[1])) : size_t(1e9);
+    size_t query_count = argc > 2 ? size_t(std::stod(argv[2])) : size_t(1e7);
+
+    cout << "generating " << kmer_count << " kmers" << endl;
+    auto kmers = synthetic_kmers(kmer_count);
+    auto queries = synthetic_queries(kmers, query_count);
+
+    std::vector<int> reference, found;
+    auto base = run_layout(kmers, queries, SearchLayout::BUCKET, false, reference);
+    for (auto layout : {SearchLayout::BUCKET, SearchLayout::INTERPOLATION})
+        for (bool batched : {false, true})
+        {
+            if (layout == SearchLayout::BUCKET && !batched)
+                continue;
+            auto speed = run_layout(kmers, queries, layout, batched, found);
+            ASSERT(found == reference);
+            cout << search_layout_name(layout) << (batched ? " batched" : "") << "\tspeedup vs bucket " << double(speed) / std::max(base, size_t(1)) << endl;
+        }
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include <random>
+#include "tests.h"
+#include "kway_merge.h"
+
+struct Element
+{
+    uint64_t value;
+    int run;
+    Element(uint64_t value = 0, int run = 0) : value(value), run(run) {}
+    bool operator < (const Element &x) const { return value < x.value; }
+};
+
+void check_merge(size_t runs_count, size_t max_run_size, uint64_t max_value)
+{
+    std::mt19937_64 rng(runs_count * 1000 + max_run_size);
+    std::vector<std::vector<uint64_t>> runs_data(runs_count);
+    std::vector<SortedRun<uint64_t>> runs;
+    std::vector<Element> expected;
+    for (size_t r = 0; r < runs_count; r++)
+    {
+        auto &data = runs_data[r];
+        data.resize(rng() % (max_run_size + 1));
+        for (auto &x : data)
+            x = rng() % max_value;
+
+        std::sort(data.begin(), data.end());
+        runs.push_back(SortedRun<uint64_t>(data.data(), data.data() + data.size()));
+        for (auto x : data)
+            expected.push_back(Element(x, int(r)));
+    }
+
+    std::stable_sort(expected.begin(), expected.end());
+
+    std::vector<Element> merged(expected.size());
+    kway_merge(runs, merged.data(), [](uint64_t value, size_t run) { return Element(value, int(run)); });
+
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        ASSERT_EQUALS(merged[i].value, expected[i].value);
+        ASSERT_EQUALS(merged[i].run, expected[i].run);
+    }
+}
+
+TEST(kway_merge_small) {
+    check_merge(0, 10, 100);
+    check_merge(1, 10, 100);
+    check_merge(5, 10, 100);
+}
+
+TEST(kway_merge_parts) {
+    check_merge(3, 100000, uint64_t(-1)); // several parts
+    check_merge(1000, 500, uint64_t(-1)); // many runs
+    check_merge(50, 10000, 1000); // equal values across runs and parts
+}
+
+TEST_MAIN();
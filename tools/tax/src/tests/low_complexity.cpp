@@ -0,0 +1,104 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include <random>
+#include "tests.h"
+
+typedef uint64_t hash_t;
+
+#include "dbs.h"
+#include "low_complexity.h"
+
+std::string random_kmer(std::mt19937 &rng, int kmer_len)
+{
+    std::string kmer;
+    auto letters = rng() % 4 + 1; // few letters give repeats
+    auto period = rng() % 3 + 1;
+    for (int i = 0; i < kmer_len; i++)
+        kmer += (i >= int(period) && rng() % 4 != 0) ? kmer[i - period] : "ACGT"[rng() % letters];
+
+    return kmer;
+}
+
+std::string reverse_complement(std::string s)
+{
+    seq_transform_actg::to_rev_complement(s);
+    return s;
+}
+
+bool is_low_complexity(const std::string &kmer)
+{
+    auto score = LowComplexity::min_score(int(kmer.size()));
+    return LowComplexity::predicted(kmer) >= score || LowComplexity::predicted(reverse_complement(kmer)) >= score;
+}
+
+TEST(low_complexity_packed_score) {
+    std::mt19937 rng(11);
+    ASSERT_EQUALS(LowComplexity::predicted(Hash<hash_t>::hash_of("AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"), 32), 28);
+    ASSERT_EQUALS(LowComplexity::predicted(Hash<hash_t>::hash_of("ACACACACACACACACACACACACACACACAC"), 32), 24);
+    for (int kmer_len = 1; kmer_len <= 32; kmer_len++)
+        for (int i = 0; i < 20000; i++)
+        {
+            auto kmer = random_kmer(rng, kmer_len);
+            auto packed = Hash<hash_t>::hash_of(kmer);
+            ASSERT_EQUALS(LowComplexity::predicted(packed, kmer_len), LowComplexity::predicted(kmer));
+            ASSERT_EQUALS(LowComplexity::reverse_predicted(packed, kmer_len), LowComplexity::predicted(reverse_complement(kmer)));
+            ASSERT_EQUALS(LowComplexity::is_low_complexity(packed, kmer_len), is_low_complexity(kmer));
+        }
+}
+
+TEST(low_complexity_filter) {
+    std::mt19937 rng(12);
+    const int KMER_LEN = 32;
+    for (size_t count : { 0, 1, 1000, 300000 })
+    {
+        std::vector<DBS::KmerTax> kmers, expected;
+        for (size_t i = 0; i < count; i++)
+        {
+            auto kmer = random_kmer(rng, KMER_LEN);
+            kmers.push_back(DBS::KmerTax(Hash<hash_t>::hash_of(kmer), int(i)));
+            if (!is_low_complexity(kmer))
+                expected.push_back(kmers.back());
+        }
+
+        std::vector<hash_t> hashes;
+        for (auto &kmer : kmers)
+            hashes.push_back(kmer.kmer);
+
+        ASSERT_EQUALS(LowComplexity::filter(kmers, KMER_LEN), count - expected.size());
+        ASSERT_EQUALS(kmers.size(), expected.size());
+        for (size_t i = 0; i < kmers.size(); i++)
+        {
+            ASSERT_EQUALS(kmers[i].kmer, expected[i].kmer);
+            ASSERT_EQUALS(kmers[i].tax_id, expected[i].tax_id);
+        }
+
+        ASSERT_EQUALS(LowComplexity::filter(hashes, KMER_LEN), count - expected.size());
+        ASSERT_EQUALS(hashes.size(), expected.size());
+    }
+}
+
+TEST_MAIN();
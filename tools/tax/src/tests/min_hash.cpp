@@ -0,0 +1,104 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include <random>
+#include "tests.h"
+
+typedef uint64_t hash_t;
+
+#include "min_hash.h"
+
+// sketch as finish() computed it before: one scan of the stored hashes per mask
+void reference_finish(MinHash &min_hash)
+{
+	for (size_t ib = 0; ib < min_hash.best.size(); ib++)
+	{
+		auto _xor = min_hash.xors[ib];
+		for (size_t i = 0; i < min_hash.storage_hash.size(); i++)
+		{
+			auto h = min_hash.storage_hash[i] ^ _xor;
+			if (h < min_hash.best[ib].hash)
+				min_hash.best[ib] = MinHash::Best(h, min_hash.storage_kmer[i]);
+		}
+	}
+
+	min_hash.storage_hash.clear();
+	min_hash.storage_kmer.clear();
+}
+
+void add_random(MinHash &a, MinHash &b, std::mt19937_64 &rng, size_t count, uint64_t distinct)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		auto kmer = hash_t(rng() % distinct); // few distinct values give repeated hashes
+		auto hash = (kmer + 1) * 0x9E3779B97F4A7C15ull;
+		a.add(hash, kmer);
+		b.add(hash, kmer);
+	}
+}
+
+void assert_same(const MinHash &a, const MinHash &b)
+{
+	ASSERT_EQUALS(a.best.size(), b.best.size());
+	for (size_t i = 0; i < a.best.size(); i++)
+	{
+		ASSERT_EQUALS(a.best[i].hash, b.best[i].hash);
+		ASSERT_EQUALS(a.best[i].kmer, b.best[i].kmer);
+	}
+}
+
+TEST(min_hash_same_as_reference) {
+	std::mt19937_64 rng(7);
+	for (size_t mask_count : { 1, 3, 4, 5, 64, 1001 })
+		for (size_t count : { 0, 1, 7, 100, 5000, 100000 })
+			for (uint64_t distinct : { uint64_t(3), uint64_t(1000), UINT64_MAX })
+			{
+				MinHash min_hash(mask_count), reference(mask_count);
+				for (int round = 0; round < 3; round++) // finish() can be called again after more adds
+				{
+					add_random(min_hash, reference, rng, count, distinct);
+					min_hash.finish();
+					reference_finish(reference);
+					assert_same(min_hash, reference);
+					ASSERT(min_hash.storage_hash.empty());
+				}
+			}
+}
+
+TEST(min_hash_extreme_hashes) {
+	MinHash min_hash(100), reference(100);
+	for (uint64_t hash : { uint64_t(0), UINT64_MAX, uint64_t(1) << 63, (uint64_t(1) << 63) - 1 })
+	{
+		min_hash.add(hash, hash_t(hash / 3));
+		reference.add(hash, hash_t(hash / 3));
+	}
+
+	min_hash.finish();
+	reference_finish(reference);
+	assert_same(min_hash, reference);
+}
+
+TEST_MAIN();
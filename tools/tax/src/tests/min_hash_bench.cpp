@@ -0,0 +1,91 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+// one pass min hash sketching against one scan per mask, on random hashes
+// usage: min_hash_bench [hash count, default 1e7] [mask count, default 1024]
+
+#include <random>
+#include "tests.h"
+#include "omp_adapter.h"
+
+typedef uint64_t hash_t;
+
+#include "min_hash.h"
+
+// finish() as it was before, one scan of the stored hashes per mask
+void per_mask_finish(MinHash &min_hash)
+{
+	#pragma omp parallel for
+	for (int ib = 0; ib < int(min_hash.best.size()); ib++)
+	{
+		auto best = min_hash.best[ib];
+		auto _xor = min_hash.xors[ib];
+		for (size_t i = 0; i < min_hash.storage_hash.size(); i++)
+		{
+			auto h = min_hash.storage_hash[i] ^ _xor;
+			if (h < best.hash)
+				best = MinHash::Best(h, min_hash.storage_kmer[i]);
+		}
+
+		min_hash.best[ib] = best;
+	}
+
+	min_hash.storage_hash.clear();
+	min_hash.storage_kmer.clear();
+}
+
+template <class Finish>
+double run(MinHash &min_hash, const std::vector<uint64_t> &hashes, Finish &&finish)
+{
+	for (auto hash : hashes)
+		min_hash.add(hash, hash_t(hash >> 2));
+
+	auto before = high_resolution_clock::now();
+	finish(min_hash);
+	return duration_cast<duration<double>>(high_resolution_clock::now() - before).count();
+}
+
+int main(int argc, char const *argv[])
+{
+	size_t hash_count = argc > 1 ? size_t(std::stod(argv[1])) : size_t(1e7);
+	size_t mask_count = argc > 2 ? size_t(std::stod(argv[2])) : 1024;
+
+	std::mt19937_64 rng(1);
+	std::vector<uint64_t> hashes(hash_count);
+	for (auto &hash : hashes)
+		hash = rng();
+
+	MinHash one_pass(mask_count), per_mask(mask_count);
+	auto one_pass_sec = run(one_pass, hashes, [](MinHash &min_hash) { min_hash.finish(); });
+	auto per_mask_sec = run(per_mask, hashes, per_mask_finish);
+
+	for (size_t i = 0; i < mask_count; i++)
+		ASSERT(one_pass.best[i].kmer == per_mask.best[i].kmer);
+
+	cout << "hashes " << hash_count << "\tmasks " << mask_count << "\tthreads " << omp_get_max_threads() << endl;
+	cout << "per mask\tsec " << per_mask_sec << "\thashes*masks/sec " << hash_count * mask_count / std::max(per_mask_sec, 1e-9) << endl;
+	cout << "one pass\tsec " << one_pass_sec << "\thashes*masks/sec " << hash_count * mask_count / std::max(one_pass_sec, 1e-9) << "\tspeedup " << per_mask_sec / std::max(one_pass_sec, 1e-9) << endl;
+}
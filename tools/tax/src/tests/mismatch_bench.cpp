@@ -0,0 +1,121 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+// slowdown of kmer classification with up to 1-3 mismatches relative to exact matching, on synthetic canonical 32-mers
+// usage: mismatch_bench [kmer count, default 1e8] [lookup count, default 1e6]
+
+#include "tests.h"
+#include <random>
+#include "omp_adapter.h"
+
+typedef uint64_t hash_t;
+
+#include "dbs.h"
+#include "kmer_search.h"
+#include "mismatch_index.h"
+
+struct KmerTax : public DBS::KmerTax
+{
+    KmerTax(hash_t kmer = 0, int tax_id = 0) : DBS::KmerTax(kmer, tax_id) {}
+    bool operator < (const KmerTax &x) const { return kmer < x.kmer; }
+};
+
+static const int KMER_LEN = 32;
+
+std::vector<KmerTax> synthetic_kmers(size_t count)
+{
+    std::vector<KmerTax> kmers(count);
+    #pragma omp parallel
+    {
+        std::mt19937_64 rng(omp_get_thread_num());
+        #pragma omp for
+        for (size_t i = 0; i < count; i++)
+            kmers[i] = KmerTax(seq_transform<hash_t>::min_hash_variant(rng(), KMER_LEN), int(i % 1000) + 1);
+    }
+    parallel_sort(kmers);
+    return kmers;
+}
+
+// queries are db kmers with 0, 1, 2, 3 substituted letters and random kmers, in equal shares
+std::vector<hash_t> synthetic_queries(const std::vector<KmerTax> &kmers, size_t count)
+{
+    std::mt19937_64 rng(12345);
+    std::vector<hash_t> queries(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        hash_t kmer = (i % 5 == 4) ? rng() : kmers[rng() % kmers.size()].kmer;
+        for (size_t s = 0; s < i % 5 && s < 4; s++)
+            kmer ^= hash_t(rng() % 3 + 1) << (2 * (rng() % KMER_LEN));
+        queries[i] = seq_transform<hash_t>::min_hash_variant(kmer, KMER_LEN);
+    }
+    return queries;
+}
+
+// lookups per second, found is number of classified queries
+template <class Find>
+size_t run(const std::vector<hash_t> &queries, Find &&find, size_t &found)
+{
+    found = 0;
+    auto before = high_resolution_clock::now();
+    #pragma omp parallel for reduction(+:found)
+    for (size_t i = 0; i < queries.size(); i++)
+        if (find(queries[i]))
+            found++;
+
+    auto seconds = duration_cast<duration<double>>(high_resolution_clock::now() - before).count();
+    return size_t(queries.size() / std::max(seconds, 1e-9));
+}
+
+int main(int argc, char const *argv[])
+{
+    size_t kmer_count = argc > 1 ? size_t(std::stod(argv[1])) : size_t(1e8);
+    size_t query_count = argc > 2 ? size_t(std::stod(argv[2])) : size_t(1e6);
+
+    cout << "generating " << kmer_count << " kmers" << endl;
+    auto kmers = synthetic_kmers(kmer_count);
+    auto queries = synthetic_queries(kmers, query_count);
+
+    KmerSearch<KmerTax, hash_t> search(kmers.data(), kmers.size(), KMER_LEN);
+    size_t exact_found = 0;
+    auto exact_speed = run(queries, [&](hash_t kmer) { return search.find(kmer) != nullptr; }, exact_found);
+    cout << "exact\tlookups/sec " << exact_speed << "\tclassified " << double(exact_found) / queries.size() << "\tthreads " << omp_get_max_threads() << endl;
+
+    for (int mismatches = 1; mismatches <= MismatchIndex::MAX_MISMATCHES; mismatches++)
+    {
+        auto before = high_resolution_clock::now();
+        MismatchIndex index(KMER_LEN, mismatches);
+        index.build(kmers.data(), kmers.size());
+        auto build_sec = duration_cast<seconds>(high_resolution_clock::now() - before).count();
+
+        size_t found = 0;
+        auto speed = run(queries, [&](hash_t kmer) { return search.find(kmer) != nullptr || index.find(kmer) != 0; }, found);
+        ASSERT(found >= exact_found);
+        cout << mismatches << " mismatches\tlookups/sec " << speed << "\tclassified " << double(found) / queries.size() 
+            << "\tslowdown " << double(exact_speed) / std::max(speed, size_t(1)) << "\tcopies " << index.copies() << "\tbuild (sec) " << build_sec << endl;
+    }
+
+    return 0;
+}
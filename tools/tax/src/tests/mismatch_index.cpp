@@ -0,0 +1,142 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include <random>
+#include <cstdio>
+#include "tests.h"
+
+typedef uint64_t hash_t;
+
+#include "mismatch_index.h"
+
+struct KmerTax : public DBS::KmerTax
+{
+    KmerTax(hash_t kmer = 0, int tax_id = 0) : DBS::KmerTax(kmer, tax_id) {}
+    bool operator < (const KmerTax &x) const { return kmer < x.kmer; }
+};
+
+hash_t mutate(hash_t kmer, int kmer_len, int substitutions, std::mt19937_64 &rng)
+{
+    for (int i = 0; i < substitutions; i++)
+        kmer ^= hash_t(rng() % 3 + 1) << (2 * (rng() % kmer_len)); // may hit the same letter twice
+    return kmer;
+}
+
+int closest_tax(const std::vector<KmerTax> &db, hash_t query, int kmer_len, int max_mismatches)
+{
+    int best_mismatches = max_mismatches + 1, best_tax = 0;
+    auto rev_compl = seq_transform<hash_t>::to_rev_complement(query, kmer_len);
+    for (auto &k : db)
+    {
+        int mismatches = std::min(MismatchIndex::letter_mismatches(k.kmer, query), MismatchIndex::letter_mismatches(k.kmer, rev_compl));
+        if (mismatches < best_mismatches || (mismatches == best_mismatches && k.tax_id < best_tax))
+        {
+            best_mismatches = mismatches;
+            best_tax = k.tax_id;
+        }
+    }
+
+    return best_tax;
+}
+
+void check_index(int kmer_len, int max_mismatches)
+{
+    std::mt19937_64 rng(kmer_len * 10 + max_mismatches);
+    hash_t mask = kmer_len == 32 ? hash_t(-1) : (hash_t(1) << (2 * kmer_len)) - 1;
+    std::vector<KmerTax> db;
+    for (int i = 0; i < 3000; i++)
+        db.push_back(KmerTax(seq_transform<hash_t>::min_hash_variant(rng() & mask, kmer_len), i % 50 + 1));
+
+    std::sort(db.begin(), db.end());
+
+    MismatchIndex index(kmer_len, max_mismatches);
+    index.build(db.data(), db.size());
+
+    for (int i = 0; i < 3000; i++)
+    {
+        auto query = db[rng() % db.size()].kmer;
+        if (i % 2)
+            query = seq_transform<hash_t>::to_rev_complement(query, kmer_len);
+
+        query = seq_transform<hash_t>::min_hash_variant(mutate(query, kmer_len, i % (max_mismatches + 2), rng), kmer_len);
+        ASSERT_EQUALS(index.find(query), closest_tax(db, query, kmer_len, max_mismatches));
+    }
+}
+
+TEST(mismatch_index_1) {
+    check_index(32, 1);
+    check_index(25, 1);
+}
+
+TEST(mismatch_index_2) {
+    check_index(32, 2);
+    check_index(17, 2);
+}
+
+TEST(mismatch_index_3) {
+    check_index(32, 3);
+    check_index(31, 3);
+}
+
+TEST(mismatch_index_save_load) {
+    std::vector<KmerTax> db;
+    for (int i = 1; i <= 1000; i++)
+        db.push_back(KmerTax(seq_transform<hash_t>::min_hash_variant(hash_t(i) * 0x9E3779B97F4A7C15ull, 32), i));
+
+    std::sort(db.begin(), db.end());
+
+    MismatchIndex built(32, 2);
+    built.build(db.data(), db.size());
+    built.save("mismatch_index_test.dbs");
+
+    MismatchIndex loaded(32, 2);
+    ASSERT(!loaded.load("mismatch_index_test.dbs", db.data(), db.size() - 1));
+    ASSERT(loaded.load("mismatch_index_test.dbs", db.data(), db.size()));
+    for (auto &k : db)
+        ASSERT_EQUALS(loaded.find(k.kmer ^ 3), built.find(k.kmer ^ 3));
+
+    // same number of kmers, other contents
+    auto changed = db;
+    changed[500].tax_id++;
+    ASSERT(!MismatchIndex(32, 2).load("mismatch_index_test.dbs", changed.data(), changed.size()));
+
+    // damaged copy is not loaded, so that it is rebuilt
+    auto first_copy = built.copy_filename("mismatch_index_test.dbs", 0);
+    auto size = IO::filesize(first_copy);
+    std::vector<char> data(size);
+    std::ifstream(first_copy, std::ios::binary).read(data.data(), size);
+    const size_t SOURCE_SIZE = 3 * sizeof(uint64_t); // identity at the end is kept
+    std::ofstream(first_copy, std::ios::binary).write(data.data(), size / 2).write(data.data() + size - SOURCE_SIZE, SOURCE_SIZE);
+    ASSERT(!MismatchIndex(32, 2).load("mismatch_index_test.dbs", db.data(), db.size()));
+    data[offsetof(DBSIO::DBSMappedHeader, checksum)] ^= 1;
+    std::ofstream(first_copy, std::ios::binary).write(data.data(), size);
+    ASSERT(!MismatchIndex(32, 2).load("mismatch_index_test.dbs", db.data(), db.size()));
+
+    for (size_t copy = 0; copy < built.copies(); copy++)
+        std::remove(built.copy_filename("mismatch_index_test.dbs", copy).c_str());
+}
+
+TEST_MAIN();
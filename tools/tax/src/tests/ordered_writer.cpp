@@ -0,0 +1,166 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include <random>
+#include <thread>
+#include <atomic>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include "tests.h"
+
+typedef uint64_t hash_t;
+
+#include "ordered_writer.h"
+#include "config_align_to.h"
+#include "aligns_to_dbs_job.h"
+
+const int THREADS = 4;
+
+TEST(ordered_writer_threads) {
+    const size_t CHUNKS = 2000;
+    std::ostringstream out;
+    {
+        OrderedWriter writer(out, 8);
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < THREADS; t++)
+            threads.push_back(std::thread([&, t]() {
+                std::mt19937 rng(t);
+                for (size_t seq; (seq = next++) < CHUNKS; )
+                {
+                    if (rng() % 8 == 0)
+                        std::this_thread::sleep_for(std::chrono::microseconds(rng() % 200));
+                    writer.put(seq, std::to_string(seq) + "\n");
+                }
+            }));
+
+        for (auto &thread : threads)
+            thread.join();
+
+        writer.finish();
+    }
+
+    std::ostringstream expected;
+    for (size_t seq = 0; seq < CHUNKS; seq++)
+        expected << seq << std::endl;
+    ASSERT_EQUALS(out.str(), expected.str());
+}
+
+TEST(ordered_writer_missing_chunk) {
+    std::ostringstream out;
+    OrderedWriter writer(out, 8);
+    writer.put(0, "0\n");
+    writer.put(2, "2\n");
+    bool thrown = false;
+    try { writer.finish(); } catch (std::runtime_error &) { thrown = true; }
+    ASSERT(thrown);
+    ASSERT_EQUALS(out.str(), "0\n");
+}
+
+// producer failed, threads waiting for its chunk are released
+TEST(ordered_writer_abort) {
+    std::ostringstream out;
+    OrderedWriter writer(out, 2);
+    writer.put(0, "0\n");
+    std::thread waiting([&]() {
+        for (size_t seq = 2; seq < 10; seq++)
+            writer.put(seq, std::to_string(seq) + "\n");
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    writer.abort();
+    waiting.join();
+    ASSERT_EQUALS(out.str(), "0\n");
+}
+
+// -ordered prints matched reads in the order of the input, whatever thread matched them
+TEST(aligns_to_ordered) {
+    const int KMER_LEN = 32;
+    const char *DBS_FILE = "ordered_writer_test.dbs";
+    const char *FASTA_FILE = "ordered_writer_test.fasta";
+
+    std::mt19937 rng(5);
+    std::string genome;
+    for (int i = 0; i < 2000; i++)
+        genome += "ACGT"[rng() % 4];
+
+    std::vector<DBSJob::KmerTax> db;
+    Hash<hash_t>::for_all_canonical_hashes_do(genome, KMER_LEN, [&](hash_t kmer, int) {
+        db.push_back(DBSJob::KmerTax(kmer, 1));
+        return true;
+    });
+    std::sort(db.begin(), db.end(), [](const DBSJob::KmerTax &a, const DBSJob::KmerTax &b) { return a.kmer < b.kmer; });
+    db.erase(std::unique(db.begin(), db.end(), [](const DBSJob::KmerTax &a, const DBSJob::KmerTax &b) { return a.kmer == b.kmer; }), db.end());
+    DBSIO::save_dbs(DBS_FILE, db, KMER_LEN);
+
+    // several chunks of reads, every other read matches
+    std::ofstream fasta(FASTA_FILE);
+    std::vector<std::string> matched;
+    for (int i = 0; i < 20000; i++)
+    {
+        std::string bases;
+        if (i % 2 == 0)
+        {
+            bases = genome.substr(rng() % 1900, 100);
+            matched.push_back("read" + std::to_string(i));
+        }
+        else
+            for (int j = 0; j < 100; j++)
+                bases += "ACGT"[rng() % 4];
+
+        fasta << ">read" << i << std::endl << bases << std::endl;
+    }
+    fasta.close();
+
+    omp_set_num_threads(THREADS);
+    const char *argv[] = { "aligns_to", "-dbs", DBS_FILE, "-ordered", "-hide_counts", FASTA_FILE };
+    Config config(6, argv);
+    DBSBasicJob job(config);
+    std::ostringstream out;
+    job.run(FASTA_FILE, out);
+
+    std::istringstream lines(out.str());
+    std::string line;
+    size_t i = 0;
+    while (std::getline(lines, line))
+    {
+        ASSERT(i < matched.size());
+        ASSERT_EQUALS(line.substr(0, line.find('\t')), matched[i]);
+        i++;
+    }
+    ASSERT_EQUALS(i, matched.size());
+
+    // bad read after many good ones fails the run instead of terminating or hanging
+    std::ofstream(FASTA_FILE, std::ios::app) << ">bad" << std::endl << ">read" << std::endl << "ACGT" << std::endl;
+    bool thrown = false;
+    try { job.run(FASTA_FILE, out); } catch (std::runtime_error &) { thrown = true; }
+    ASSERT(thrown);
+
+    std::remove(DBS_FILE);
+    std::remove(FASTA_FILE);
+}
+
+TEST_MAIN();
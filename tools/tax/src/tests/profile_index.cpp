@@ -0,0 +1,204 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include <random>
+#include <cstdio>
+#include <utime.h>
+#include "tests.h"
+
+typedef uint64_t hash_t;
+
+#include "profile_index.h"
+
+const char *INDEX_FILE = "profile_index_test.idx";
+const size_t PROFILE_LEN = 300;
+
+typedef std::vector<std::vector<hash_t>> Profiles;
+
+Profiles random_profiles(size_t count, std::mt19937_64 &rng)
+{
+    Profiles profiles(count, std::vector<hash_t>(PROFILE_LEN));
+    for (auto &profile : profiles)
+        for (auto &kmer : profile)
+            kmer = rng();
+
+    return profiles;
+}
+
+// keeps every kmer with probability similarity
+std::vector<hash_t> similar_profile(const std::vector<hash_t> &profile, double similarity, std::mt19937_64 &rng)
+{
+    auto similar = profile;
+    std::uniform_real_distribution<double> dist(0, 1);
+    for (auto &kmer : similar)
+        if (dist(rng) >= similarity)
+            kmer = rng();
+
+    return similar;
+}
+
+std::vector<std::string> names(size_t count)
+{
+    std::vector<std::string> filenames;
+    for (size_t i = 0; i < count; i++)
+        filenames.push_back(std::to_string(i) + ".profile");
+
+    return filenames;
+}
+
+void build(const Profiles &profiles)
+{
+    ProfileIndex::build(INDEX_FILE, profiles.size(), PROFILE_LEN, ProfileIndex::source_hash(names(profiles.size()), std::vector<std::string>()), [&](size_t i, std::vector<hash_t> &kmers)
+    {
+        kmers = profiles[i];
+    });
+}
+
+template <class Lambda>
+bool throws(Lambda &&lambda)
+{
+    try
+    {
+        lambda();
+    }
+    catch (std::runtime_error &)
+    {
+        return true;
+    }
+
+    return false;
+}
+
+TEST(profile_index_candidates) {
+    std::mt19937_64 rng(5);
+    auto profiles = random_profiles(1000, rng);
+    build(profiles);
+
+    ProfileIndex index(INDEX_FILE);
+    ASSERT_EQUALS(index.profile_count(), profiles.size());
+    ASSERT_EQUALS(index.profile_len(), PROFILE_LEN);
+    auto source_hash = ProfileIndex::source_hash(names(profiles.size()), std::vector<std::string>());
+    ASSERT(index.matches(profiles.size(), source_hash));
+    ASSERT(!index.matches(profiles.size() - 1, source_hash));
+    ASSERT(!index.matches(profiles.size(), ProfileIndex::source_hash(names(profiles.size() - 1), std::vector<std::string>())));
+
+    for (uint32_t i = 0; i < profiles.size(); i += 7)
+    {
+        auto same = index.candidates(profiles[i]);
+        ASSERT(std::binary_search(same.begin(), same.end(), i));
+        ASSERT(std::is_sorted(same.begin(), same.end()));
+
+        auto similar = index.candidates(similar_profile(profiles[i], 0.8, rng));
+        ASSERT(std::binary_search(similar.begin(), similar.end(), i)); // misses with probability ~1e-20
+    }
+
+    size_t unrelated = 0;
+    for (int i = 0; i < 100; i++)
+        unrelated += index.candidates(random_profiles(1, rng)[0]).size();
+    ASSERT_EQUALS(unrelated, 0);
+
+    std::remove(INDEX_FILE);
+}
+
+// profiles regenerated under the same names make the index stale
+TEST(profile_index_source_changed) {
+    const char *PROFILE_FILE = "profile_index_test.profile";
+    std::vector<std::string> files(1, PROFILE_FILE);
+    std::ofstream(PROFILE_FILE) << "1\n2\n";
+    auto before = ProfileIndex::source_hash(files, files);
+    ASSERT_EQUALS(ProfileIndex::source_hash(files, files), before);
+    ASSERT(!ProfileIndex::is_current(INDEX_FILE, 1, before)); // missing
+
+    std::mt19937_64 rng(7);
+    auto profiles = random_profiles(1, rng);
+    ProfileIndex::build(INDEX_FILE, 1, PROFILE_LEN, before, [&](size_t i, std::vector<hash_t> &kmers) { kmers = profiles[i]; });
+    ASSERT(ProfileIndex::is_current(INDEX_FILE, 1, before));
+
+    std::ofstream(PROFILE_FILE) << "1\n2\n3\n";
+    auto resized = ProfileIndex::source_hash(files, files);
+    ASSERT(resized != before);
+    ASSERT(!ProfileIndex::is_current(INDEX_FILE, 1, resized));
+
+    utimbuf times;
+    times.actime = times.modtime = 1000000000;
+    ASSERT_EQUALS(utime(PROFILE_FILE, &times), 0);
+    auto touched = ProfileIndex::source_hash(files, files);
+    ASSERT(touched != resized);
+
+    std::remove(PROFILE_FILE);
+    ASSERT(throws([&]() { ProfileIndex::source_hash(files, files); }));
+
+    std::ofstream(INDEX_FILE) << "short";
+    ASSERT(!ProfileIndex::is_current(INDEX_FILE, 1, before)); // damaged
+
+    std::remove(INDEX_FILE);
+}
+
+// another process may still use the index being rebuilt
+TEST(profile_index_rebuild_while_mapped) {
+    std::mt19937_64 rng(8);
+    auto profiles = random_profiles(100, rng);
+    build(profiles);
+    ProfileIndex old_index(INDEX_FILE);
+
+    build(random_profiles(50, rng));
+    ASSERT_EQUALS(old_index.profile_count(), profiles.size());
+    auto same = old_index.candidates(profiles[10]);
+    ASSERT(std::binary_search(same.begin(), same.end(), uint32_t(10)));
+    ASSERT_EQUALS(ProfileIndex(INDEX_FILE).profile_count(), 50);
+
+    // failed build leaves the index and no temporary file
+    ASSERT(throws([&]() { ProfileIndex::build(INDEX_FILE, 10, PROFILE_LEN, 0, [&](size_t i, std::vector<hash_t> &kmers) { if (i == 5) throw std::runtime_error("bad profile"); kmers = profiles[i]; }); }));
+    ASSERT_EQUALS(ProfileIndex(INDEX_FILE).profile_count(), 50);
+    ASSERT(!std::ifstream(std::string(INDEX_FILE) + ".tmp." + std::to_string(getpid())).good());
+
+    std::remove(INDEX_FILE);
+}
+
+TEST(profile_index_errors) {
+    std::mt19937_64 rng(6);
+    auto profiles = random_profiles(10, rng);
+    ASSERT(throws([&]() { ProfileIndex::build(INDEX_FILE, 10, PROFILE_LEN, 0, [&](size_t i, std::vector<hash_t> &kmers) { kmers = profiles[i]; }, 101, 3); }));
+    ASSERT(throws([&]() { ProfileIndex::build(INDEX_FILE, 10, PROFILE_LEN, 0, [&](size_t i, std::vector<hash_t> &kmers) { kmers.assign(i + 1, 0); }); }));
+
+    build(profiles);
+    ProfileIndex index(INDEX_FILE);
+    ASSERT(throws([&]() { index.candidates(std::vector<hash_t>(PROFILE_LEN - 1)); }));
+
+    {
+        std::ofstream f(INDEX_FILE, std::ios::binary | std::ios::out | std::ios::in);
+        f.seekp(sizeof(size_t) * 2); // profile_count
+        f.put(11);
+    }
+    ASSERT(throws([&]() { ProfileIndex damaged(INDEX_FILE); }));
+
+    std::ofstream(INDEX_FILE) << "short";
+    ASSERT(throws([&]() { ProfileIndex truncated(INDEX_FILE); }));
+
+    std::remove(INDEX_FILE);
+}
+
+TEST_MAIN();
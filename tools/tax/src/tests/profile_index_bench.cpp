@@ -0,0 +1,127 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+// recall and speed of lsh index candidates against the linear scan, on synthetic profiles
+// every query is a copy of a random profile with a share of its kmers replaced
+// usage: profile_index_bench [profile count, default 1e5] [profile len, default 1000] [query count, default 100]
+
+#include <random>
+#include <cstdio>
+#include "tests.h"
+#include "omp_adapter.h"
+
+typedef uint64_t hash_t;
+
+#include "profile_index.h"
+
+const char *INDEX_FILE = "profile_index_bench.idx";
+
+double similarity(const std::vector<hash_t> &a, const std::vector<hash_t> &b)
+{
+    size_t same = 0;
+    for (size_t i = 0; i < a.size(); i++)
+        same += a[i] == b[i];
+
+    return double(same) / a.size();
+}
+
+double seconds_since(high_resolution_clock::time_point before)
+{
+    return duration_cast<duration<double>>(high_resolution_clock::now() - before).count();
+}
+
+int main(int argc, char const *argv[])
+{
+    size_t profile_count = argc > 1 ? size_t(std::stod(argv[1])) : size_t(1e5);
+    size_t profile_len = argc > 2 ? size_t(std::stod(argv[2])) : 1000;
+    size_t query_count = argc > 3 ? size_t(std::stod(argv[3])) : 100;
+
+    std::mt19937_64 rng(1);
+    std::vector<std::vector<hash_t>> profiles(profile_count, std::vector<hash_t>(profile_len));
+    for (auto &profile : profiles)
+        for (auto &kmer : profile)
+            kmer = rng() % 100000; // small alphabet gives background similarity
+
+    auto before = high_resolution_clock::now();
+    ProfileIndex::build(INDEX_FILE, profile_count, profile_len, 0, [&](size_t i, std::vector<hash_t> &kmers) { kmers = profiles[i]; });
+    cout << "profiles " << profile_count << "\tlen " << profile_len << "\tthreads " << omp_get_max_threads() << "\tbuild sec " << seconds_since(before) << endl;
+
+    ProfileIndex index(INDEX_FILE);
+    std::uniform_real_distribution<double> dist(0, 1);
+    for (double share : { 0.9, 0.7, 0.5, 0.4, 0.3, 0.2 })
+    {
+        std::vector<std::vector<hash_t>> queries(query_count);
+        std::vector<uint32_t> sources(query_count);
+        for (size_t q = 0; q < query_count; q++)
+        {
+            sources[q] = uint32_t(rng() % profile_count);
+            queries[q] = profiles[sources[q]];
+            for (auto &kmer : queries[q])
+                if (dist(rng) >= share)
+                    kmer = rng() % 100000;
+        }
+
+        // linear scan finds the best profile, index is right if the best is among candidates
+        before = high_resolution_clock::now();
+        std::vector<uint32_t> best(query_count);
+        #pragma omp parallel for
+        for (size_t q = 0; q < query_count; q++)
+        {
+            double best_sim = -1;
+            for (uint32_t i = 0; i < profile_count; i++)
+            {
+                auto sim = similarity(queries[q], profiles[i]);
+                if (sim > best_sim)
+                {
+                    best_sim = sim;
+                    best[q] = i;
+                }
+            }
+        }
+        auto linear_sec = seconds_since(before);
+
+        before = high_resolution_clock::now();
+        size_t found = 0, candidate_count = 0;
+        #pragma omp parallel for reduction(+:found, candidate_count)
+        for (size_t q = 0; q < query_count; q++)
+        {
+            auto candidates = index.candidates(queries[q]);
+            candidate_count += candidates.size();
+            double best_sim = -1;
+            for (auto i : candidates)
+                best_sim = std::max(best_sim, similarity(queries[q], profiles[i]));
+
+            if (best_sim == similarity(queries[q], profiles[best[q]]))
+                found++;
+        }
+        auto indexed_sec = seconds_since(before);
+
+        cout << "kept " << share << "\trecall " << double(found) / query_count << "\tcandidates " << double(candidate_count) / query_count
+            << "\tlinear queries/sec " << query_count / std::max(linear_sec, 1e-9) << "\tindexed queries/sec " << query_count / std::max(indexed_sec, 1e-9) << endl;
+    }
+
+    std::remove(INDEX_FILE);
+}
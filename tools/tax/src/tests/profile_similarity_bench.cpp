@@ -0,0 +1,93 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+// all-vs-all profile comparisons with every available equality count kernel, on synthetic profiles in a mapped store
+// usage: profile_similarity_bench [profile count, default 1e4] [profile len, default 1000]
+
+#include <random>
+#include <cstdio>
+#include "tests.h"
+#include "omp_adapter.h"
+
+typedef uint64_t hash_t;
+
+#include "profile_store.h"
+#include "profile_similarity.h"
+
+const char *STORE_FILE = "profile_similarity_bench.profiles";
+
+int main(int argc, char const *argv[])
+{
+    size_t profile_count = argc > 1 ? size_t(std::stod(argv[1])) : size_t(1e4);
+    size_t profile_len = argc > 2 ? size_t(std::stod(argv[2])) : 1000;
+
+    {
+        std::mt19937_64 rng(1);
+        ProfileStore profiles;
+        std::vector<hash_t> kmers(profile_len);
+        for (size_t i = 0; i < profile_count; i++)
+        {
+            for (auto &kmer : kmers)
+                kmer = rng() % 16;
+            profiles.add(std::to_string(i), kmers);
+        }
+        profiles.save(STORE_FILE);
+    }
+
+    ProfileStore profiles(STORE_FILE);
+    cout << "profiles " << profile_count << "\tlen " << profile_len << "\tthreads " << omp_get_max_threads() << "\tchosen kernel " << ProfileSimilarity::kernel_name() << endl;
+
+    std::vector<std::pair<const char*, ProfileSimilarity::CountEqual>> kernels = { { "scalar", ProfileSimilarity::count_equal_scalar } };
+#if PROFILE_SIMILARITY_X86
+    if (__builtin_cpu_supports("sse4.2"))
+        kernels.push_back({ "sse4.2", ProfileSimilarity::count_equal_sse42 });
+    if (__builtin_cpu_supports("avx2"))
+        kernels.push_back({ "avx2", ProfileSimilarity::count_equal_avx2 });
+#endif
+
+    size_t expected = 0;
+    for (auto &kernel : kernels)
+    {
+        auto before = high_resolution_clock::now();
+        size_t total = 0;
+        #pragma omp parallel for schedule(dynamic, 16) reduction(+:total)
+        for (size_t i = 0; i < profile_count; i++)
+            for (size_t j = i + 1; j < profile_count; j++)
+                total += kernel.second(profiles.kmers(i), profiles.kmers(j), profile_len);
+
+        auto seconds = duration_cast<duration<double>>(high_resolution_clock::now() - before).count();
+        if (expected == 0)
+            expected = total;
+        ASSERT_EQUALS(total, expected);
+
+        double pairs = double(profile_count) * (profile_count - 1) / 2;
+        double per_second = pairs / std::max(seconds, 1e-9);
+        cout << kernel.first << "\tpairs/sec " << per_second << "\tGB/sec " << per_second * profile_len * 2 * sizeof(hash_t) / 1e9
+            << "\t100k all-vs-all hours " << 1e5 * (1e5 - 1) / 2 / per_second / 3600 << endl;
+    }
+
+    std::remove(STORE_FILE);
+}
@@ -0,0 +1,127 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include <random>
+#include <cstdio>
+#include "tests.h"
+
+typedef uint64_t hash_t;
+
+#include "profile_store.h"
+#include "profile_similarity.h"
+
+const char *STORE_FILE = "profile_store_test.profiles";
+
+std::vector<ProfileSimilarity::CountEqual> kernels()
+{
+    std::vector<ProfileSimilarity::CountEqual> available = { ProfileSimilarity::count_equal_scalar, ProfileSimilarity::count_equal };
+#if PROFILE_SIMILARITY_X86
+    if (__builtin_cpu_supports("sse4.2"))
+        available.push_back(ProfileSimilarity::count_equal_sse42);
+    if (__builtin_cpu_supports("avx2"))
+        available.push_back(ProfileSimilarity::count_equal_avx2);
+#endif
+    return available;
+}
+
+TEST(profile_similarity_kernels) {
+    std::mt19937_64 rng(9);
+    std::vector<hash_t> a(300), b(300);
+    for (size_t len = 0; len < 100; len++)
+        for (size_t offset = 0; offset < 3; offset++) // unaligned starts
+            for (int round = 0; round < 5; round++)
+            {
+                size_t expected = 0;
+                for (size_t i = 0; i < len; i++)
+                {
+                    a[offset + i] = rng() % 4; // equal about a quarter of the time
+                    b[offset + i] = (i % 5 == 0) ? a[offset + i] : rng() % 4;
+                    expected += a[offset + i] == b[offset + i];
+                }
+
+                for (auto kernel : kernels())
+                    ASSERT_EQUALS(kernel(&a[offset], &b[offset], len), expected);
+            }
+
+    ProfileSimilarity sim;
+    ASSERT_EQUALS(sim(a.data(), a.data(), 10), 1.0);
+    std::cerr << "kernel " << ProfileSimilarity::kernel_name() << std::endl;
+}
+
+template <class Lambda>
+bool throws(Lambda &&lambda)
+{
+    try
+    {
+        lambda();
+    }
+    catch (std::runtime_error &)
+    {
+        return true;
+    }
+
+    return false;
+}
+
+TEST(profile_store_save_and_map) {
+    ASSERT(ProfileStore::is_store("a/b.profiles"));
+    ASSERT(!ProfileStore::is_store("a/b.profile"));
+    ASSERT(!ProfileStore::is_store("profiles"));
+
+    std::mt19937_64 rng(10);
+    ProfileStore profiles;
+    std::vector<std::vector<hash_t>> kmers(50, std::vector<hash_t>(77));
+    for (size_t i = 0; i < kmers.size(); i++)
+    {
+        for (auto &kmer : kmers[i])
+            kmer = rng();
+        profiles.add("dir/" + std::to_string(i) + ".profile", kmers[i]);
+    }
+
+    ASSERT(throws([&]() { profiles.add("short", std::vector<hash_t>(76)); }));
+    ASSERT(throws([&]() { profiles.add("bad\nname", kmers[0]); }));
+    ASSERT_EQUALS(profiles.size(), kmers.size());
+
+    profiles.save(STORE_FILE);
+    ProfileStore mapped(STORE_FILE);
+    ASSERT_EQUALS(mapped.size(), kmers.size());
+    ASSERT_EQUALS(mapped.profile_len(), size_t(77));
+    ASSERT(mapped.filenames() == profiles.filenames());
+    for (size_t i = 0; i < kmers.size(); i++)
+        ASSERT(std::equal(kmers[i].begin(), kmers[i].end(), mapped.kmers(i)));
+    ASSERT(throws([&]() { mapped.add("more", kmers[0]); }));
+
+    ProfileStore().save(STORE_FILE); // replaced, the mapped one keeps the previous file
+    ASSERT_EQUALS(ProfileStore(STORE_FILE).size(), size_t(0));
+    ASSERT(std::equal(kmers.back().begin(), kmers.back().end(), mapped.kmers(kmers.size() - 1)));
+
+    std::ofstream(STORE_FILE) << "short";
+    ASSERT(throws([&]() { ProfileStore truncated(STORE_FILE); }));
+
+    std::remove(STORE_FILE);
+}
+
+TEST_MAIN();
@@ -30,9 +30,12 @@
 
 #include "vdb_reader.h"
 #include "fasta_reader.h"
+#include "fastq_reader.h"
 #include "mt_reader.h"
 #include "aux_reader.h"
 
+#include <sstream>
+
 class DummyReader: public Reader {
     size_t idx;
     std::vector<std::string> reads;
@@ -89,6 +92,19 @@ static std::vector<std::string> read_all_bases(ReaderPtr reader) {
     return result;
 }
 
+template <typename ReaderPtr>
+static std::vector<Reader::Fragment> read_all_chunks(ReaderPtr reader, size_t max_count) {
+    std::vector<Reader::Fragment> result;
+    Reader::Chunk chunk;
+    while (reader->read_chunk(chunk, max_count)) {
+        for (size_t i = 0; i < chunk.size(); ++i) {
+            result.emplace_back();
+            chunk.get(i, &result.back());
+        }
+    }
+    return result;
+}
+
 template <typename ReaderType>
 struct Helper {
     template <typename ...Args>
@@ -97,6 +113,12 @@ struct Helper {
         return ::read_all(&reader);
     }
 
+    template <typename ...Args>
+    static std::vector<Reader::Fragment> read_all_chunks(size_t max_count, Args... args) {
+        ReaderType reader(args...);
+        return ::read_all_chunks(&reader, max_count);
+    }
+
     template <typename ...Args>
     static std::vector<std::string> read_all_bases(Args... args) {
         ReaderType reader(args...);
@@ -266,6 +288,67 @@ TEST(mt_reader) {
     test_mt_reader<AlignedVdbReader>("aligned vdb", "./tests/data/SRR1068106");
 }
 
+template <typename ReaderType, typename ...Args>
+void test_read_chunk(Args... args) {
+    auto reference = Helper<ReaderType>::read_all(args...);
+    for (size_t max_count = 1; max_count <= 4096; max_count <<= 4) {
+        ASSERT(Helper<ReaderType>::read_all_chunks(max_count, args...) == reference);
+    }
+}
+TEST(read_chunk) {
+    const std::vector<std::string> source = {"ACGT", "NACGT", "ACNNGT", "", "NNN", "TTN", "GATTACA"};
+    test_read_chunk<DummyReader>(source);
+    test_read_chunk<SplittingReader<DummyReader> >(source);
+    test_read_chunk<CuttingReader<DummyReader> >(source);
+    test_read_chunk<FastaReader>("./tests/data/SRR1068106.fasta");
+    test_read_chunk<FastaReader>("./tests/data/multiline_reads.fasta");
+    test_read_chunk<SplittingReader<FastaReader> >("./tests/data/SRR1068106.fasta");
+    test_read_chunk<FilteringReader<FastaReader, IncludeFileSpotFilter> >(IncludeFileSpotFilter("./tests/data/filter.spots"), "./tests/data/SRR1068106.fasta");
+
+    auto reference = Helper<SplittingReader<FastaReader> >::read_all("./tests/data/SRR1068106.fasta");
+    std::sort(reference.begin(), reference.end(), FragmentSort());
+    for (int thread_count = 1; thread_count <= 16; thread_count <<= 2) {
+        auto result = Helper<SplittingReader<MTReader<FastaReader> > >::read_all_chunks(Reader::DEFAULT_CHUNK_SIZE, thread_count, size_t(16), "./tests/data/SRR1068106.fasta");
+        std::sort(result.begin(), result.end(), FragmentSort());
+        ASSERT(reference == result);
+    }
+}
+
+TEST(compressed_and_fastq_reader) {
+    auto reference = Helper<FastaReader>::read_all("./tests/data/SRR1068106.fasta");
+    ASSERT(Helper<FastaReader>::read_all("./tests/data/SRR1068106.fasta.gz") == reference);
+    ASSERT(Helper<FastaReader>::read_all("./tests/data/SRR1068106.bgzf.fasta.gz") == reference);
+    for (int thread_count = 0; thread_count <= 16; thread_count = std::max(1, thread_count << 2)) {
+        InputStreambuf buf("./tests/data/SRR1068106.bgzf.fasta.gz", thread_count);
+        ASSERT_EQUALS(buf.inflate_thread_count(), size_t(thread_count > 1 ? thread_count : 0));
+        std::istream in(&buf);
+        std::ostringstream out;
+        out << in.rdbuf();
+        ASSERT_EQUALS(out.str().size(), 110045);
+    }
+    for (int thread_count = 0; thread_count <= 4; thread_count += 4) {
+        Reader::Params params;
+        params.thread_count = thread_count; // also used for inflating
+        ASSERT(read_all(Reader::create("./tests/data/SRR1068106.bgzf.fasta.gz", params)) == reference);
+    }
+    ASSERT(Helper<FastqReader>::read_all("./tests/data/SRR1068106.fastq") == reference);
+    test_read_chunk<FastqReader>("./tests/data/SRR1068106.fastq");
+
+    auto with_qual = Helper<FastqReader>::read_all("./tests/data/SRR1068106.fastq", true);
+    ASSERT_EQUALS(with_qual.size(), reference.size());
+    ASSERT_EQUALS(with_qual[0].bases[3], '!'); // every 10th quality is low
+    ASSERT_EQUALS(with_qual[0].bases.substr(4, 9), reference[0].bases.substr(4, 9));
+
+    ASSERT(FastaReader::is_fasta("reads.fa.gz"));
+    ASSERT(FastqReader::is_fastq("reads.fq.gz"));
+    ASSERT(!FastqReader::is_fastq("reads.fasta.gz"));
+    auto from_factory = read_all(Reader::create("./tests/data/SRR1068106.bgzf.fasta.gz"));
+    auto from_factory_plain = read_all(Reader::create("./tests/data/SRR1068106.fasta"));
+    std::sort(from_factory.begin(), from_factory.end(), FragmentSort());
+    std::sort(from_factory_plain.begin(), from_factory_plain.end(), FragmentSort());
+    ASSERT(from_factory == from_factory_plain);
+}
+
 TEST(filtering_reader) {
     std::vector<std::string> source = {"A", "C", "T", "G"};
     auto filter1 = [](const std::string& spotid) { return spotid != "2"; };
@@ -123,4 +123,32 @@ TEST(seq_transform_3) {
 //	ASSERT_EQUALS(seq_transform_actg::apply_transformation("TAAAAAAAAACTGGGG", false, true), "ATTTTTTTTTGACCCC");
 }
 
+TEST(seq_transform_rolling) {
+    typedef uint64_t hash_t;
+    const int KMER_LEN = 32;
+    srand(1);
+    string seq;
+    for (int i = 0; i < 10000; i++)
+        seq += (rand() % 100 == 0) ? 'N' : "ACGT"[rand() % 4];
+
+    RollingKmer<hash_t> kmer(KMER_LEN);
+    int last_n = -1, checked = 0;
+    for (int i = 0; i < int(seq.length()); i++)
+    {
+        if (seq[i] == 'N')
+            last_n = i;
+
+        bool valid = kmer.add(seq[i]);
+        ASSERT_EQUALS(valid, i - last_n >= KMER_LEN);
+        if (!valid)
+            continue;
+
+        auto hash = Hash<hash_t>::hash_of(&seq[i - KMER_LEN + 1], KMER_LEN);
+        ASSERT_EQUALS(kmer.canonical(), seq_transform<hash_t>::min_hash_variant(hash, KMER_LEN));
+        checked++;
+    }
+
+    ASSERT(checked > 0);
+}
+
 TEST_MAIN();
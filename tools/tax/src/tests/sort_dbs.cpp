@@ -0,0 +1,143 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include <random>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include "tests.h"
+
+typedef uint64_t hash_t;
+
+#include "sort_dbs.h"
+
+const char *INPUT_FILE = "sort_dbs_test.dbs";
+const char *RUN_PREFIX = "sort_dbs_test_runs";
+
+std::string file_data(const std::string &filename)
+{
+    std::ifstream f(filename, std::ios::binary);
+    std::ostringstream s;
+    s << f.rdbuf();
+    return s.str();
+}
+
+bool exists(const std::string &filename)
+{
+    return std::ifstream(filename).good();
+}
+
+// few distinct values give many equal (tax, kmer) pairs
+std::vector<DBS::KmerTax> random_kmers(size_t count, size_t distinct_kmers, int taxes, std::mt19937_64 &rng)
+{
+    std::vector<DBS::KmerTax> kmers;
+    for (size_t i = 0; i < count; i++)
+        kmers.push_back(DBS::KmerTax(distinct_kmers ? rng() % distinct_kmers : rng(), int(rng() % taxes) + 1));
+    return kmers;
+}
+
+void check_external_sort(const std::vector<DBS::KmerTax> &kmers)
+{
+    DBSIO::save_dbs(INPUT_FILE, kmers, 32);
+
+    auto in_memory = SortDBS::sort(INPUT_FILE, "sort_dbs_test_memory.dbss", RUN_PREFIX, kmers.size(), false);
+    ASSERT_EQUALS(in_memory.runs, 0u);
+    ASSERT_EQUALS(in_memory.kmers, kmers.size());
+
+    auto external = SortDBS::sort(INPUT_FILE, "sort_dbs_test_external.dbss", RUN_PREFIX, kmers.size() / 37 + 1, false);
+    ASSERT(external.runs > 30);
+    ASSERT_EQUALS(external.kmers, kmers.size());
+    for (size_t run = 0; run < external.runs; run++)
+        ASSERT(!exists(std::string(RUN_PREFIX) + ".run." + std::to_string(run)));
+
+    ASSERT(file_data("sort_dbs_test_memory.dbss") == file_data("sort_dbs_test_external.dbss"));
+    ASSERT_EQUALS(file_data("sort_dbs_test_memory.dbss.annotation"), file_data("sort_dbs_test_external.dbss.annotation"));
+
+    // expected: hashes by tax, then kmer, and count of every tax
+    SortDBS::Kmers sorted(kmers.size());
+    for (size_t i = 0; i < kmers.size(); i++)
+        static_cast<DBS::KmerTax&>(sorted[i]) = kmers[i];
+    std::sort(sorted.begin(), sorted.end());
+
+    std::vector<hash_t> hashes;
+    ASSERT_EQUALS(DBSIO::load_dbs("sort_dbs_test_external.dbss", hashes), 32u);
+    ASSERT_EQUALS(hashes.size(), sorted.size());
+    std::ostringstream annotation;
+    for (size_t i = 0, start = 0; i < sorted.size(); i++)
+    {
+        ASSERT_EQUALS(hashes[i], sorted[i].kmer);
+        if (i + 1 == sorted.size() || sorted[i + 1].tax_id != sorted[i].tax_id)
+        {
+            annotation << sorted[i].tax_id << '\t' << i + 1 - start << std::endl;
+            start = i + 1;
+        }
+    }
+
+    ASSERT_EQUALS(file_data("sort_dbs_test_external.dbss.annotation"), annotation.str());
+
+    for (auto file : { "sort_dbs_test_memory.dbss", "sort_dbs_test_external.dbss" })
+    {
+        std::remove(file);
+        std::remove((std::string(file) + ".annotation").c_str());
+    }
+    std::remove(INPUT_FILE);
+}
+
+TEST(sort_dbs_external) {
+    std::mt19937_64 rng(1);
+    check_external_sort(random_kmers(300000, 0, 500, rng));
+}
+
+TEST(sort_dbs_external_duplicates) {
+    std::mt19937_64 rng(2);
+    check_external_sort(random_kmers(200000, 5, 3, rng));
+    check_external_sort(std::vector<DBS::KmerTax>(100000, DBS::KmerTax(7, 1)));
+}
+
+TEST(sort_dbs_runs_removed_on_error) {
+    std::mt19937_64 rng(3);
+    auto kmers = random_kmers(10000, 0, 10, rng);
+    kmers[5000].tax_id = 0; // found by annotation during the merge
+    DBSIO::save_dbs(INPUT_FILE, kmers, 32);
+
+    bool failed = false;
+    try
+    {
+        SortDBS::sort(INPUT_FILE, "sort_dbs_test_error.dbss", RUN_PREFIX, 1000, false);
+    }
+    catch (std::exception &)
+    {
+        failed = true;
+    }
+
+    ASSERT(failed);
+    ASSERT(exists(std::string(RUN_PREFIX) + ".run.0") == false);
+    ASSERT(exists(std::string(RUN_PREFIX) + ".run.9") == false);
+    std::remove("sort_dbs_test_error.dbss");
+    std::remove(INPUT_FILE);
+}
+
+TEST_MAIN();
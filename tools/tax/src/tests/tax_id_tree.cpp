@@ -0,0 +1,148 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include <random>
+#include <fstream>
+#include <cstdio>
+#include "tests.h"
+#include "tax_id_tree.h"
+
+const tax_id_t ROOT = TaxIdTree::ROOT;
+
+// random tree of the given size, tax ids are shuffled and spread over [2, max_tax_id]
+std::vector<FlatTaxIdTree::Parent> random_tree(int size, tax_id_t max_tax_id, int max_children, std::mt19937 &rng)
+{
+    std::vector<tax_id_t> ids;
+    std::set<tax_id_t> used = { ROOT };
+    while (int(ids.size()) < size)
+    {
+        tax_id_t id = 2 + rng() % (max_tax_id - 1);
+        if (used.insert(id).second)
+            ids.push_back(id);
+    }
+
+    std::vector<FlatTaxIdTree::Parent> parents;
+    std::vector<int> children(size, 0);
+    for (int i = 0; i < size; i++)
+    {
+        int p = i == 0 ? -1 : int(rng() % i);
+        while (p >= 0 && children[p] >= max_children)
+            p = p == 0 ? -1 : int(rng() % p);
+
+        if (p >= 0)
+            children[p]++;
+        parents.push_back(FlatTaxIdTree::Parent(ids[i], p < 0 ? ROOT : ids[p]));
+    }
+
+    std::shuffle(parents.begin(), parents.end(), rng);
+    return parents;
+}
+
+void check_same(int size, tax_id_t max_tax_id, int max_children, int seed)
+{
+    std::mt19937 rng(seed);
+    auto parents = random_tree(size, max_tax_id, max_children, rng);
+
+    TaxIdTree tree;
+    for (auto &p : parents)
+        tree.nodes[p.first] = new TaxIdTree::Node(p.first, p.second);
+    TaxIdTreeLoader::calculate_subids(tree);
+
+    FlatTaxIdTree flat;
+    flat.build(parents);
+    ASSERT_EQUALS(flat.size(), size_t(size + 1));
+
+    std::vector<tax_id_t> ids = { ROOT };
+    for (auto &p : parents)
+        ids.push_back(p.first);
+
+    for (int i = 0; i < 20000; i++)
+    {
+        auto a = ids[rng() % ids.size()];
+        auto b = i % 10 == 0 ? a : ids[rng() % ids.size()];
+        ASSERT_EQUALS(flat.consensus_of(a, b), tree.consensus_of(a, b));
+        ASSERT_EQUALS(flat.a_sub_b(a, b), tree.a_sub_b(a, b));
+        if (a != ROOT)
+            ASSERT_EQUALS(flat.get_parent_id(a), tree.get_parent_id(a));
+    }
+}
+
+TEST(flat_tax_id_tree_small) {
+    for (int seed = 0; seed < 50; seed++)
+        check_same(1 + seed % 20, 100, 1 + seed % 3, seed);
+}
+
+TEST(flat_tax_id_tree_deep) {
+    check_same(3000, 100000, 1, 1); // a path
+    check_same(3000, 100000, 2, 2);
+}
+
+TEST(flat_tax_id_tree_wide) {
+    check_same(5000, 10000, 1000, 3);
+    check_same(5000, 4000000000u, 20, 4); // sparse tax ids
+}
+
+TEST(flat_tax_id_tree_errors) {
+    FlatTaxIdTree flat;
+    flat.build({ {2, 1}, {3, 2}, {4, 2} });
+    ASSERT_EQUALS(flat.consensus_of(3, 4), 2u);
+    ASSERT_EQUALS(flat.consensus_of(5, 5), 5u);
+    ASSERT(!flat.a_sub_b(5, 3));
+
+    bool thrown = false;
+    try { flat.consensus_of(3, 5); } catch (std::runtime_error&) { thrown = true; }
+    ASSERT(thrown);
+
+    thrown = false;
+    try { FlatTaxIdTree().build({ {2, 3}, {3, 2} }); } catch (std::runtime_error&) { thrown = true; }
+    ASSERT(thrown);
+
+    thrown = false;
+    try { FlatTaxIdTree().build({ {2, 7} }); } catch (std::runtime_error&) { thrown = true; }
+    ASSERT(thrown);
+}
+
+bool loads(const std::string &text)
+{
+    const char *FILENAME = "tax_id_tree_test.parents";
+    std::ofstream(FILENAME) << text;
+    bool loaded = true;
+    FlatTaxIdTree flat;
+    try { TaxIdTreeLoader::load_tax_id_tree(flat, FILENAME); } catch (std::runtime_error&) { loaded = false; }
+    std::remove(FILENAME);
+    return loaded;
+}
+
+TEST(flat_tax_id_tree_load) {
+    ASSERT(loads("2\t1\n3\t2\n"));
+    ASSERT(loads("2\t1\n3\t2"));
+    ASSERT(!loads("2\t1\nx\t2\n3\t2\n")); // malformed line does not cut the tree short
+    ASSERT(!loads("2\t1\n3\n"));
+    ASSERT(!loads("2\t1\n0\t2\n"));
+    ASSERT(!loads("2\t0\n"));
+}
+
+TEST_MAIN();
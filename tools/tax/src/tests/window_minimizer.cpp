@@ -0,0 +1,91 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include <random>
+#include "tests.h"
+
+typedef uint64_t hash_t;
+
+#include "window_minimizer.h"
+#include "kmer_io.h"
+
+// kmers as build_index chose them before: every window scanned from scratch
+std::vector<hash_t> reference_window_kmers(const std::string &s, int window_size, int kmer_len)
+{
+    std::vector<hash_t> kmers;
+    int len = int(s.size());
+    for (int start = 0; start <= len - window_size; start += window_size)
+    {
+        int from = std::max(0, start - (kmer_len - 1));
+        int to = std::min(start + window_size, len);
+        if (to - from < kmer_len)
+            continue;
+
+        auto min_hash = std::numeric_limits<KmerHash::hash_of_hash_t>::max();
+        int min_hash_pos = -1;
+        for (int pos = from; pos <= to - kmer_len; pos++)
+        {
+            auto h = KmerHash::hash_of(KmerIO::kmer_from(s.c_str(), pos, kmer_len));
+            if (h < min_hash)
+            {
+                min_hash = h;
+                min_hash_pos = pos;
+            }
+        }
+
+        kmers.push_back(KmerIO::kmer_from(s.c_str(), min_hash_pos, kmer_len));
+    }
+
+    return kmers;
+}
+
+std::vector<hash_t> window_kmers(const std::string &s, int window_size, int kmer_len)
+{
+    std::vector<hash_t> kmers;
+    WindowMinimizer::for_all_windows_do(s.c_str(), int(s.size()), window_size, kmer_len, [&](hash_t kmer, int pos)
+    {
+        ASSERT_EQUALS(kmer, KmerIO::kmer_from(s.c_str(), pos, kmer_len));
+        kmers.push_back(kmer);
+    });
+    return kmers;
+}
+
+TEST(window_minimizer_same_as_reference) {
+    std::mt19937 rng(3);
+    int window_sizes[] = { 1, 7, 20, 31, 32, 33, 50, 200, 2000 };
+    int kmer_lens[] = { 12, 25, 32 };
+    for (int kmer_len : kmer_lens)
+        for (int window_size : window_sizes)
+            for (int len : { 0, 5, 31, 32, 33, 64, 199, 200, 201, 1000, 4321 })
+            {
+                std::string s;
+                for (int i = 0; i < len; i++)
+                    s += "ACGT"[rng() % (i % 500 < 100 ? 2 : 4)]; // low complexity parts give hash ties
+                ASSERT(window_kmers(s, window_size, kmer_len) == reference_window_kmers(s, window_size, kmer_len));
+            }
+}
+
+TEST_MAIN();
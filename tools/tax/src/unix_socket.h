@@ -0,0 +1,224 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#ifndef UNIX_SOCKET_H_INCLUDED
+#define UNIX_SOCKET_H_INCLUDED
+
+#include <string>
+#include <streambuf>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+// stream socket in the local (unix) domain, closed on destruction
+class UnixSocket
+{
+	int fd;
+
+	static sockaddr_un address(const std::string &path)
+	{
+		sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(addr.sun_path))
+			throw std::runtime_error("socket path is too long: " + path);
+
+		strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+		return addr;
+	}
+
+	static int new_socket()
+	{
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0)
+			throw std::runtime_error(std::string("cannot create socket: ") + strerror(errno));
+
+		return fd;
+	}
+
+	explicit UnixSocket(int fd) : fd(fd) {}
+
+	static bool is_listened(const sockaddr_un &addr)
+	{
+		UnixSocket probe(new_socket());
+		return ::connect(probe.fd, (const sockaddr*)&addr, sizeof(addr)) == 0;
+	}
+
+public:
+	UnixSocket(UnixSocket &&other) : fd(other.fd) { other.fd = -1; }
+	UnixSocket(const UnixSocket&) = delete;
+	UnixSocket& operator= (const UnixSocket&) = delete;
+	~UnixSocket() { if (fd >= 0) close(fd); }
+
+	// replaces a stale socket file left by a previous server
+	// fails if the path is another file or a socket some server still listens on
+	static UnixSocket listen(const std::string &path)
+	{
+		UnixSocket s(new_socket());
+		auto addr = address(path);
+		struct stat st;
+		if (lstat(path.c_str(), &st) == 0)
+		{
+			if (!S_ISSOCK(st.st_mode))
+				throw std::runtime_error("cannot listen on " + path + ": file exists and is not a socket");
+
+			if (is_listened(addr))
+				throw std::runtime_error("cannot listen on " + path + ": another server is listening on it");
+
+			unlink(path.c_str());
+		}
+
+		if (bind(s.fd, (sockaddr*)&addr, sizeof(addr)) != 0)
+			throw std::runtime_error("cannot bind socket " + path + ": " + strerror(errno));
+
+		if (::listen(s.fd, 16) != 0)
+			throw std::runtime_error("cannot listen on socket " + path + ": " + strerror(errno));
+
+		return s;
+	}
+
+	static UnixSocket connect(const std::string &path)
+	{
+		UnixSocket s(new_socket());
+		auto addr = address(path);
+		if (::connect(s.fd, (sockaddr*)&addr, sizeof(addr)) != 0)
+			throw std::runtime_error("cannot connect to socket " + path + ": " + strerror(errno));
+
+		return s;
+	}
+
+	UnixSocket accept()
+	{
+		while (true)
+		{
+			int client = ::accept(fd, nullptr, nullptr);
+			if (client >= 0)
+				return UnixSocket(client);
+
+			if (errno != EINTR)
+				throw std::runtime_error(std::string("cannot accept connection: ") + strerror(errno));
+		}
+	}
+
+	// returns false if peer has gone
+	bool send_all(const char *data, size_t size)
+	{
+		while (size > 0)
+		{
+			auto sent = ::send(fd, data, size, MSG_NOSIGNAL);
+			if (sent < 0 && errno == EINTR)
+				continue;
+
+			if (sent <= 0)
+				return false;
+
+			data += sent;
+			size -= sent;
+		}
+
+		return true;
+	}
+
+	bool send_all(const std::string &s) { return send_all(s.data(), s.size()); }
+
+	// returns 0 at the end of stream
+	size_t receive(char *data, size_t size)
+	{
+		while (true)
+		{
+			auto received = ::recv(fd, data, size, 0);
+			if (received >= 0)
+				return size_t(received);
+
+			if (errno != EINTR)
+				throw std::runtime_error(std::string("cannot receive: ") + strerror(errno));
+		}
+	}
+
+	// tells peer that the request is complete
+	void shutdown_send() { ::shutdown(fd, SHUT_WR); }
+};
+
+// buffered reading and writing through a socket, so that std streams can be used on it
+class SocketStreambuf : public std::streambuf
+{
+	UnixSocket &socket;
+	char in_buf[64 * 1024];
+	char out_buf[64 * 1024];
+
+public:
+	SocketStreambuf(UnixSocket &socket) : socket(socket)
+	{
+		setg(in_buf, in_buf, in_buf);
+		setp(out_buf, out_buf + sizeof(out_buf));
+	}
+
+	~SocketStreambuf() { sync(); }
+
+protected:
+	virtual int_type underflow()
+	{
+		if (gptr() < egptr())
+			return traits_type::to_int_type(*gptr());
+
+		auto received = socket.receive(in_buf, sizeof(in_buf));
+		if (received == 0)
+			return traits_type::eof();
+
+		setg(in_buf, in_buf, in_buf + received);
+		return traits_type::to_int_type(*gptr());
+	}
+
+	virtual int_type overflow(int_type ch)
+	{
+		if (sync() != 0)
+			return traits_type::eof();
+
+		if (!traits_type::eq_int_type(ch, traits_type::eof()))
+		{
+			*pptr() = traits_type::to_char_type(ch);
+			pbump(1);
+		}
+
+		return traits_type::not_eof(ch);
+	}
+
+	virtual int sync()
+	{
+		auto size = pptr() - pbase();
+		if (size > 0 && !socket.send_all(pbase(), size))
+			return -1;
+
+		setp(out_buf, out_buf + sizeof(out_buf));
+		return 0;
+	}
+};
+
+#endif
@@ -134,24 +134,36 @@ public:
 class VdbReader final: public BaseVdbReader {
 private:
     const ngs::Read::ReadCategory category;
+    const size_t first_row; // 0-based
+    const size_t row_count;
     ngs::ReadIterator it;
     bool eof;
     size_t spot_count;
 
 public:
+    static const bool SEEKABLE = true;
+
 	VdbReader(const std::string& acc, bool read_qualities = false, bool unaligned_only = false)
+        : VdbReader(Part(), acc, read_qualities, unaligned_only)
+    {}
+
+    // reads only rows of the part
+	VdbReader(const Part& part, const std::string& acc, bool read_qualities = false, bool unaligned_only = false)
         : BaseVdbReader(acc, read_qualities)
         , category((unaligned_only && is_aligned(run)) ? ngs::Read::unaligned : ngs::Read::all)
-        , it(run.getReads(category))
+        , first_row(part.begin(run.getReadCount()))
+        , row_count(part.end(run.getReadCount()) - first_row)
+        , it(run.getReadRange(first_row + 1, row_count, category))
     {
-        spot_count = run.getReadCount(category);
-        eof = !it.nextRead();
+        spot_count = run.getReadCount(category) / part.count;
+        spot_idx = first_row;
+        eof = row_count == 0 || !it.nextRead();
     }
 
     SourceStats stats() const override { return stats_for_category(category); }
 
     float progress() const override {
-        return spot_count ? float(spot_idx) / spot_count : 1;
+        return spot_count ? std::min(1.0f, float(spot_idx - first_row) / spot_count) : 1;
     }
 
     bool read(Fragment* output) override {
@@ -182,6 +194,8 @@ private:
         READING_EOF,
     };
 
+    const size_t first_alignment; // 0-based
+    const size_t first_row;
     ngs::AlignmentIterator alit;
     ngs::ReadIterator pit;
 	ngs::ReadIterator uit;
@@ -191,24 +205,34 @@ private:
     size_t spot_count;
 
 public:
+    static const bool SEEKABLE = true;
+
 	AlignedVdbReader(const std::string& acc, bool read_qualities = false)
+        : AlignedVdbReader(Part(), acc, read_qualities)
+    {}
+
+    // reads only primary alignments and rows of the part
+	AlignedVdbReader(const Part& part, const std::string& acc, bool read_qualities = false)
         : BaseVdbReader(acc, read_qualities)
-        , alit(run.getAlignments(ngs::Alignment::primaryAlignment))
-        , pit(run.getReads(ngs::Read::partiallyAligned))
-        , uit(run.getReads(ngs::Read::unaligned))
+        , first_alignment(part.begin(run.getAlignmentCount(ngs::Alignment::primaryAlignment)))
+        , first_row(part.begin(run.getReadCount()))
+        , alit(run.getAlignmentRange(first_alignment + 1, part.end(run.getAlignmentCount(ngs::Alignment::primaryAlignment)) - first_alignment, ngs::Alignment::primaryAlignment))
+        , pit(run.getReadRange(first_row + 1, part.end(run.getReadCount()) - first_row, ngs::Read::partiallyAligned))
+        , uit(run.getReadRange(first_row + 1, part.end(run.getReadCount()) - first_row, ngs::Read::unaligned))
         , state(READING_ALIGNMNETS)
         , alignment_idx(0)
     {
-        spot_count = run.getReadCount() - run.getReadCount(ngs::Read::fullyAligned);
-        alignment_count = run.getAlignmentCount(ngs::Alignment::primaryAlignment);
+        spot_count = (run.getReadCount() - run.getReadCount(ngs::Read::fullyAligned)) / part.count;
+        alignment_count = run.getAlignmentCount(ngs::Alignment::primaryAlignment) / part.count;
+        spot_idx = first_row;
     }
 
     SourceStats stats() const override { return stats_for_category(ngs::Read::ReadCategory::all); }
 
     float progress() const override {
-        const size_t current = alignment_idx + spot_idx;
+        const size_t current = alignment_idx + spot_idx - first_row;
         const size_t total = alignment_count + spot_count;
-        return total ? float(current) / total : 1;
+        return total ? std::min(1.0f, float(current) / total) : 1;
     }
 
     bool read(Fragment* output) override {
@@ -0,0 +1,92 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#ifndef WINDOW_MINIMIZER_H_INCLUDED
+#define WINDOW_MINIMIZER_H_INCLUDED
+
+#include <limits>
+#include <stdexcept>
+#include "hash.h"
+#include "kmer_hash.h"
+
+// picks the kmer with minimal KmerHash of every window in one rolling pass
+// windows tile the string: window i holds the kmers ending in [i * window_size, (i + 1) * window_size), only whole windows count
+// ties go to the leftmost kmer
+struct WindowMinimizer
+{
+	// lambda(canonical kmer, pos) is called for every window in order, pos is where the kmer starts
+	template <class Lambda>
+	static void for_all_windows_do(const char *s, int len, int window_size, int kmer_len, Lambda &&lambda)
+	{
+		int windows = len / window_size;
+		if (windows == 0)
+			return;
+
+		auto min_hash = std::numeric_limits<KmerHash::hash_of_hash_t>::max();
+		hash_t min_kmer = 0;
+		int min_pos = -1;
+		int window = 0;
+
+		auto close_window = [&]()
+		{
+			int from = std::max(0, window * window_size - (kmer_len - 1));
+			int to = (window + 1) * window_size;
+			if (to - from >= kmer_len)
+			{
+				if (min_pos < 0)
+					throw std::runtime_error("cannot find min hash");
+
+				lambda(min_kmer, min_pos);
+			}
+
+			min_hash = std::numeric_limits<KmerHash::hash_of_hash_t>::max();
+			min_pos = -1;
+			window++;
+		};
+
+		Hash<hash_t>::for_all_canonical_hashes_do(s, windows * window_size, kmer_len, [&](hash_t kmer, int pos)
+		{
+			int kmer_window = (pos + kmer_len - 1) / window_size;
+			while (window < kmer_window)
+				close_window();
+
+			auto h = KmerHash::hash_of(kmer);
+			if (h < min_hash)
+			{
+				min_hash = h;
+				min_kmer = kmer;
+				min_pos = pos;
+			}
+
+			return true;
+		});
+
+		while (window < windows)
+			close_window();
+	}
+};
+
+#endif